@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cinttypes>
+#include <cstddef>
 
 struct Chip8
 {
@@ -11,12 +12,14 @@ struct Chip8
 		const size_t width;
 		const size_t height;
 		uint8_t *const data;
-		Screen(const size_t width, const size_t height)
-			: width(width), height(height), size(width * height), data(new uint8_t[size])
+		// Screens drawing into memory owned by someone else don't free it
+		const bool owns_data;
+		Screen(const size_t width, const size_t height, uint8_t *const external_data = nullptr)
+			: width(width), height(height), size(width * height), data(external_data ? external_data : new uint8_t[size]), owns_data(!external_data)
 		{}
 		~Screen()
 		{
-			delete data;
+			if (owns_data) delete data;
 		}
 	} screen;
 	struct Memory
@@ -83,8 +86,8 @@ struct Chip8
 		static const size_t size = 16;
 		bool data[size];
 	} keyboard;
-	Chip8(const size_t memory_size, const size_t stack_size, const size_t screen_width, const size_t screen_height)
-		: memory(Memory(memory_size)), screen(Screen(screen_width, screen_height)), stack(Stack(stack_size)), 
+	Chip8(const size_t memory_size, const size_t stack_size, const size_t screen_width, const size_t screen_height, uint8_t *const screen_data = nullptr)
+		: memory(Memory(memory_size)), screen(Screen(screen_width, screen_height, screen_data)), stack(Stack(stack_size)), 
 	    fontset(new uint8_t[80] {
 		    0xF0, 0x90, 0x90, 0x90, 0xF0, //0
 		    0x20, 0x60, 0x20, 0x20, 0x70, //1
@@ -2,30 +2,64 @@
 #include <cstdlib>
 #include <cinttypes>
 #include <ctime>
-#include <cerrno>
+#include <cstring>
 #include <SDL.h>
 #include <SDL_ttf.h>
 #include <functional>
+#include <chrono>
+#include <thread>
 // SDL pls
 #undef main
 #include "WorkingChip8.h"
 #include "filedialog.h"
+#include "Upscaler.h"
+#include "Debugger.h"
+#include "Telemetry.h"
+#include "mappedfile.h"
 
-const int pixel_scale = 10;
+int pixel_scale = 10;
 const int gui_height = 20;
 int window_width = 0;
 int window_height = 0;
 
-const unsigned int menu_item_count = 3;
+const unsigned int menu_item_count = 6;
 const int menu_item_spacing = 2;
 
 double time_scale = 1;
 
-TTF_Font *arial;
+const char *font_path = "C:\\Windows\\Fonts\\arial.ttf";
+TTF_Font *font = nullptr;
+bool font_failed = false;
+
+// Set during static initialization, as close to process start as we get
+const std::chrono::steady_clock::time_point process_start = std::chrono::steady_clock::now();
+// Text is only drawn from the second frame on so opening the font doesn't hold up the first one
+bool first_frame_presented = false;
+
+// Opens the font the first time text is drawn
+TTF_Font *get_font()
+{
+	if (!font && !font_failed)
+	{
+		if (TTF_Init() < 0)
+		{
+			printf("SDL_ttf could not initialize! SDL_Error: %s\n", TTF_GetError());
+			font_failed = true;
+			return nullptr;
+		}
+		font = TTF_OpenFont(font_path, 18);
+		if (!font)
+		{
+			printf("Font '%s' could not be opened! SDL_Error: %s\n", font_path, TTF_GetError());
+			font_failed = true;
+		}
+	}
+	return font;
+}
 
 SDL_Texture *get_string_texture(SDL_Renderer *renderer, const char *const str, SDL_Color text_color)
 {
-	SDL_Surface *message_surface = TTF_RenderText_Solid(arial, str, text_color);
+	SDL_Surface *message_surface = TTF_RenderText_Solid(get_font(), str, text_color);
 	SDL_Texture *message_texture = SDL_CreateTextureFromSurface(renderer, message_surface);
 	SDL_FreeSurface(message_surface);
 	return message_texture;
@@ -58,7 +92,7 @@ struct menu_item
 	{
 		if (title_text_width == -1 || title_text_height == -1) 
 		{
-			TTF_SizeText(arial, title, &title_text_width, &title_text_height);
+			TTF_SizeText(get_font(), title, &title_text_width, &title_text_height);
 		}
 		return { border.x + (border.w - title_text_width) / 2, border.y, title_text_width, title_text_height };
 	}
@@ -73,9 +107,7 @@ void menu_item::copy_to_renderer(SDL_Renderer *renderer, SDL_Color text_color, S
 	SDL_Rect text_rect = get_text_rect(container);
 	if (!title_texture) 
 	{
-		SDL_Surface *message_surface = TTF_RenderText_Solid(arial, title, text_color);
-		title_texture = SDL_CreateTextureFromSurface(renderer, message_surface);
-		SDL_FreeSurface(message_surface);
+		title_texture = get_string_texture(renderer, title, text_color);
 	}
 	SDL_RenderCopy(renderer, title_texture, nullptr, &text_rect);
 }
@@ -85,7 +117,7 @@ menu_item::~menu_item()
 	SDL_DestroyTexture(title_texture);
 }
 
-menu_item menu_items[menu_item_count] = { { "Load ROM" }, { "Reset" }, { "Halt" } };
+menu_item menu_items[menu_item_count] = { { "Load ROM" }, { "Reset" }, { "Halt" }, { "Filter" }, { "Debug" }, { "Stats" } };
 
 void draw_menu(SDL_Renderer *renderer)
 {
@@ -101,18 +133,218 @@ void draw_menu(SDL_Renderer *renderer)
 
 		SDL_Color text_color = { 0, 0, 0, 0 };
 
-		menu_items[i].copy_to_renderer(renderer, text_color, border);
+		if (first_frame_presented)
+		{
+			menu_items[i].copy_to_renderer(renderer, text_color, border);
+		}
+	}
+}
+
+const unsigned int telemetry_line_count = 2;
+SDL_Texture *telemetry_textures[telemetry_line_count] = { nullptr };
+unsigned int telemetry_texture_sequence = 0;
+
+void draw_telemetry(SDL_Renderer *renderer, const Telemetry &telemetry)
+{
+	const TelemetryReport &report = telemetry.report;
+	if (!telemetry_textures[0] || telemetry_texture_sequence != report.sequence)
+	{
+		char lines[telemetry_line_count][128];
+		snprintf(lines[0], sizeof(lines[0]), "IPS %.0f  frame %.1fms (p99 %.1fms)  lag p99 %.1fms",
+			report.instructions_per_second, report.frame_time_mean / 1000, report.frame_time_p99 / 1000.0, report.lag_p99 / 1000.0);
+		snprintf(lines[1], sizeof(lines[1]), "emulation %.2fms  render %.2fms  events %.2fms",
+			report.emulation_time_mean / 1000, report.render_time_mean / 1000, report.event_time_mean / 1000);
+		for (unsigned int i = 0; i < telemetry_line_count; i++)
+		{
+			SDL_DestroyTexture(telemetry_textures[i]);
+			telemetry_textures[i] = get_string_texture(renderer, lines[i], { 0xFF, 0xFF, 0xFF, 0xFF });
+		}
+		telemetry_texture_sequence = report.sequence;
+	}
+
+	// Overlay strip right below the menu bar
+	int y = gui_height;
+	for (unsigned int i = 0; i < telemetry_line_count; i++)
+	{
+		// Without a font there are no textures to draw
+		if (!telemetry_textures[i]) continue;
+		int text_width = 0;
+		int text_height = 0;
+		SDL_QueryTexture(telemetry_textures[i], nullptr, nullptr, &text_width, &text_height);
+		SDL_Rect background = { 0, y, window_width, text_height };
+		SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF);
+		SDL_RenderFillRect(renderer, &background);
+		SDL_Rect text_rect = { menu_item_spacing, y, text_width, text_height };
+		SDL_RenderCopy(renderer, telemetry_textures[i], nullptr, &text_rect);
+		y += text_height;
+	}
+}
+
+const uint8_t default_program[] = { 0x60,0x02, 0xF0,0x29, 0xD5,0x55, 0x00,0xFD };
+
+struct LaunchOptions
+{
+	const char *rom_path = nullptr;
+	// Null keeps the telemetry for the overlay only
+	const char *telemetry_path = nullptr;
+	WorkingChip8::Quirks quirks;
+	// Attach the debugger before the first instruction
+	bool debug = false;
+	// Run without a window, stops once the program halts
+	bool headless = false;
+};
+
+void print_usage(const char *const program_name)
+{
+	printf("Usage: %s [options] [rom]\n", program_name);
+	printf("  --speed <factor>    emulation speed, 1 is 60 instructions per second\n");
+	printf("  --scale <pixels>    window pixels per chip8 pixel\n");
+	printf("  --quirks <list>     comma separated: shift (8xy6/8xyE shift Vy), loadstore (Fx55/Fx65 increment I)\n");
+	printf("  --font <path>       font used for the menu\n");
+	printf("  --telemetry <path>  append main loop timings to path as one JSON line per second\n");
+	printf("  --debug             start with the debugger attached, it reads commands from the console\n");
+	printf("  --headless          run without a window until the program halts\n");
+}
+
+bool parse_quirks(const char *list, WorkingChip8::Quirks &quirks)
+{
+	while (*list)
+	{
+		const char *end = strchr(list, ',');
+		size_t length = end ? static_cast<size_t>(end - list) : strlen(list);
+		if (length == strlen("shift") && strncmp(list, "shift", length) == 0) quirks.shift_uses_vy = true;
+		else if (length == strlen("loadstore") && strncmp(list, "loadstore", length) == 0) quirks.load_store_increments_i = true;
+		else
+		{
+			printf("Unknown quirk '%.*s'\n", static_cast<int>(length), list);
+			return false;
+		}
+		list += end ? length + 1 : length;
+	}
+	return true;
+}
+
+bool parse_arguments(const int argc, char *argv[], LaunchOptions &options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (arg[0] != '-')
+		{
+			options.rom_path = arg;
+			continue;
+		}
+		if (strcmp(arg, "--debug") == 0)
+		{
+			options.debug = true;
+			continue;
+		}
+		if (strcmp(arg, "--headless") == 0)
+		{
+			options.headless = true;
+			continue;
+		}
+		if (!value || strcmp(arg, "--help") == 0)
+		{
+			return false;
+		}
+
+		if (strcmp(arg, "--speed") == 0)
+		{
+			time_scale = strtod(value, nullptr);
+			if (time_scale <= 0) return false;
+		}
+		else if (strcmp(arg, "--scale") == 0)
+		{
+			pixel_scale = static_cast<int>(strtol(value, nullptr, 10));
+			if (pixel_scale <= 0) return false;
+		}
+		else if (strcmp(arg, "--quirks") == 0)
+		{
+			if (!parse_quirks(value, options.quirks)) return false;
+		}
+		else if (strcmp(arg, "--font") == 0)
+		{
+			font_path = value;
+		}
+		else if (strcmp(arg, "--telemetry") == 0)
+		{
+			options.telemetry_path = value;
+		}
+		else
+		{
+			return false;
+		}
+		i++;
+	}
+	return true;
+}
+
+// Same speed as the windowed loop, but nothing is drawn and there are no timings to keep
+int run_headless(WorkingChip8 &working_chip, Debugger &debugger)
+{
+	const std::chrono::duration<double> frame_duration(1.0 / 60 / time_scale);
+	std::chrono::steady_clock::time_point next_frame_time = std::chrono::steady_clock::now();
+	while (!working_chip.halted)
+	{
+		if (debugger.attached) working_chip.run_cycle(debugger);
+		else working_chip.run_cycle();
+
+		next_frame_time += std::chrono::duration_cast<std::chrono::steady_clock::duration>(frame_duration);
+		std::this_thread::sleep_until(next_frame_time);
 	}
+	printf("Halted after %lu cycles\n", working_chip.cycle_count);
+	return 0;
 }
 
-int main()
+int main(int argc, char *argv[])
 {
 	srand(static_cast<unsigned int>(time(nullptr)));
 
+	LaunchOptions options;
+	if (!parse_arguments(argc, argv, options))
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
 	Chip8 chip8(4096, 16, 64, 32);
 	WorkingChip8 workingChip8(&chip8);
+	Upscaler upscaler(chip8.screen.width, chip8.screen.height);
+	upscaler.set_persistence(200);
+	Debugger debugger(chip8.memory.size);
+	Telemetry telemetry(options.telemetry_path, 1.0);
+	workingChip8.quirks = options.quirks;
+
+	MappedFile rom;
+	const uint8_t *program = default_program;
+	size_t program_size = sizeof(default_program);
+	if (options.rom_path)
+	{
+		printf("Loading %s\n", options.rom_path);
+		if (!rom.open(options.rom_path))
+		{
+			printf("Couldn't open ROM '%s'\n", options.rom_path);
+			return 4;
+		}
+		program = rom.data;
+		program_size = rom.size;
+		workingChip8.reset();
+		workingChip8.load_program(program, program_size);
+	}
+
+	if (options.debug)
+	{
+		debugger.attach();
+	}
+	if (options.headless)
+	{
+		return run_headless(workingChip8, debugger);
+	}
 
-	if (SDL_Init(SDL_INIT_EVERYTHING) < 0) 
+	// Only video, fonts and everything else are set up when they are first used
+	if (SDL_Init(SDL_INIT_VIDEO) < 0) 
 	{
 		printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
 		return -1;
@@ -141,54 +373,33 @@ int main()
 
 	SDL_RenderSetLogicalSize(renderer, window_width, window_height);
 
-	if (TTF_Init() < 0) {
-		printf("SDL_ttf could not initialize! SDL_Error: %s\n", TTF_GetError());
-		return -1;
-	};
-	arial = TTF_OpenFont("C:\\Windows\\Fonts\\arial.ttf", 18);
-
 	const char *const halt_text = "Halted";
-	SDL_Texture *halt_text_texture = get_string_texture(renderer, halt_text, { 0xFF, 0xFF, 0xFF, 0xFF });
-	int halt_text_width;
-	int halt_text_height;
-	TTF_SizeText(arial, halt_text, &halt_text_width, &halt_text_height);
-
-	const uint8_t *program = new uint8_t[8]{ 0x60,0x02, 0xF0,0x29, 0xD5,0x55, 0x00,0xFD };
-	size_t program_size = 8;
+	SDL_Texture *halt_text_texture = nullptr;
+	int halt_text_width = 0;
+	int halt_text_height = 0;
 
 	// Load ROM
-	menu_items[0].on_click = [&workingChip8, &program, &program_size]()
+	menu_items[0].on_click = [&workingChip8, &rom, &program, &program_size]()
 	{
-		// TODO
 		wchar_t path[FILEDIALOGBUFFERSIZE];
 		open_file_dialog(path);
+		if (path[0] == L'\0') return;
 		printf("Loading %S\n", path);
 
-		FILE *rom_file;
-		errno_t err = _wfopen_s(&rom_file, path, L"rb");
-		if (err != 0)
+		// Keep the current ROM until the new one is mapped, so a failed load doesn't change what Reset loads
+		MappedFile new_rom;
+		if (!new_rom.open(path))
 		{
-			size_t errmsglen = 95; // 94 char + null is the longest message
-			char *errmsg = new char[errmsglen];
-			strerror_s(errmsg, errmsglen, err);
-			printf("Couldn't Open ROM '%s'", errmsg);
-			delete errmsg;
+			printf("Couldn't open ROM\n");
 			return;
 		}
-
-		fseek(rom_file, 0, SEEK_END);
-		program_size = ftell(rom_file);
-		fseek(rom_file, 0, SEEK_SET);
-
-		delete program;
-		uint8_t *buf = new uint8_t[program_size];
-		fread(buf, sizeof(uint8_t), program_size, rom_file);
-		program = buf;
+		// The old mapping is closed when new_rom goes out of scope
+		rom.swap(new_rom);
+		program = rom.data;
+		program_size = rom.size;
 
 		workingChip8.reset();
 		workingChip8.load_program(program, program_size);
-
-		fclose(rom_file);
 	}; 
 	// Reset
 	menu_items[1].on_click = [&workingChip8, &program, &program_size]()
@@ -201,9 +412,33 @@ int main()
 	{
 		workingChip8.halted ^= 1;
 	};
+	// Filter
+	menu_items[3].on_click = [&upscaler]()
+	{
+		upscaler.filter = static_cast<UpscaleFilter>((static_cast<int>(upscaler.filter) + 1) % 3);
+		printf("Filter %s\n", get_filter_name(upscaler.filter));
+	};
+	// Debug
+	menu_items[4].on_click = [&debugger]()
+	{
+		if (debugger.attached) debugger.detach();
+		else debugger.attach();
+	};
+	// Stats
+	menu_items[5].on_click = [&telemetry]()
+	{
+		telemetry.overlay ^= 1;
+	};
 
+	uint64_t previous_frame_start = telemetry.now();
+	uint64_t next_frame_time = previous_frame_start;
 	while (true) 
 	{
+		uint64_t frame_start = telemetry.now();
+		telemetry.frame_time.record(frame_start - previous_frame_start);
+		telemetry.lag.record(frame_start > next_frame_time ? frame_start - next_frame_time : 0);
+		previous_frame_start = frame_start;
+
 		SDL_Event event;
 		while (SDL_PollEvent(&event)) 
 		{
@@ -229,33 +464,86 @@ int main()
 			}
 		}
 
-		SDL_RenderClear(renderer);
+		uint64_t events_end = telemetry.now();
+		telemetry.event_time.record(events_end - frame_start);
 
-		if (workingChip8.halted) 
+		if (!workingChip8.halted) 
 		{
-			SDL_Rect text_rect = { (window_width - halt_text_width) / 2, (window_height - halt_text_height) / 2, halt_text_width, halt_text_height };
-			SDL_RenderCopy(renderer, halt_text_texture, nullptr, &text_rect);
+			unsigned long previous_cycle_count = workingChip8.cycle_count;
+			if (debugger.attached) workingChip8.run_cycle(debugger);
+			else workingChip8.run_cycle();
+			telemetry.add_instructions(workingChip8.cycle_count - previous_cycle_count);
 		}
-		else
+
+		uint64_t emulation_end = telemetry.now();
+		telemetry.emulation_time.record(emulation_end - events_end);
+
+		SDL_RenderClear(renderer);
+
+		if (!workingChip8.halted) 
 		{
-			workingChip8.run_cycle();
+			upscaler.update(chip8.screen);
 		}
 
 		if (workingChip8.redraw) {
-			workingChip8.draw(renderer, 0, gui_height, pixel_scale);
+			SDL_Rect screen_rect = { 0, gui_height, window_width, window_height - gui_height };
+			upscaler.draw(renderer, screen_rect);
+		}
+
+		if (workingChip8.halted && first_frame_presented) 
+		{
+			if (!halt_text_texture)
+			{
+				halt_text_texture = get_string_texture(renderer, halt_text, { 0xFF, 0xFF, 0xFF, 0xFF });
+				TTF_SizeText(get_font(), halt_text, &halt_text_width, &halt_text_height);
+			}
+			SDL_Rect text_rect = { (window_width - halt_text_width) / 2, (window_height - halt_text_height) / 2, halt_text_width, halt_text_height };
+			SDL_RenderCopy(renderer, halt_text_texture, nullptr, &text_rect);
 		}
 
 		draw_menu(renderer);
 
+		if (telemetry.overlay)
+		{
+			draw_telemetry(renderer, telemetry);
+		}
+
 		SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0x00);
 		SDL_RenderPresent(renderer);
 
-		SDL_Delay(static_cast<unsigned int>((1.0f / 60 * 1000) / time_scale));
+		uint64_t render_end = telemetry.now();
+		telemetry.render_time.record(render_end - emulation_end);
+		telemetry.tick();
+
+		if (!first_frame_presented)
+		{
+			first_frame_presented = true;
+			printf("First frame presented %.1fms after start\n", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - process_start).count());
+			// Open the font in the time left of this frame, the next one draws the menu text
+			get_font();
+		}
+
+		// Sleep until the next frame is due instead of a fixed delay, so time spent on the frame isn't added on top
+		next_frame_time += static_cast<uint64_t>((1.0 / 60 * 1000000) / time_scale);
+		uint64_t now = telemetry.now();
+		if (next_frame_time > now)
+		{
+			SDL_Delay(static_cast<unsigned int>((next_frame_time - now) / 1000));
+		}
+		else if (now - next_frame_time > 1000000)
+		{
+			// More than a second behind, don't try to catch up
+			next_frame_time = now;
+		}
 	}
 	exit:
 
-	delete program;
 	SDL_DestroyTexture(halt_text_texture);
+	upscaler.release();
+	for (unsigned int i = 0; i < telemetry_line_count; i++)
+	{
+		SDL_DestroyTexture(telemetry_textures[i]);
+	}
 	SDL_DestroyRenderer(renderer);
 	SDL_DestroyWindow(window);
 	SDL_Quit();
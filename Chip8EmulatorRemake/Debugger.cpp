@@ -0,0 +1,335 @@
+#include "Debugger.h"
+#include "WorkingChip8.inl"
+#include "Disassembler.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+template bool WorkingChip8::execute<Debugger>(const uint16_t inst, Debugger &debug);
+template void WorkingChip8::run_cycle<Debugger>(Debugger &debug);
+
+static uint16_t read_instruction(const WorkingChip8 &working_chip, const uint16_t addr)
+{
+	return ((uint16_t)working_chip.chip->memory.data[addr] << 8) | working_chip.chip->memory.data[addr + 1];
+}
+
+// Splits line on whitespace into at most max_words words, returns the number of words
+static int split_words(const char *line, char words[][16], const int max_words)
+{
+	int count = 0;
+	while (count < max_words)
+	{
+		while (*line && isspace(static_cast<unsigned char>(*line))) line++;
+		if (!*line) break;
+		size_t length = 0;
+		while (*line && !isspace(static_cast<unsigned char>(*line)))
+		{
+			if (length < 15) words[count][length++] = *line;
+			line++;
+		}
+		words[count][length] = '\0';
+		count++;
+	}
+	return count;
+}
+
+// Lines read from stdin, shared with the reader thread which may outlive the debugger while it blocks in fgets
+struct LineReader
+{
+	std::mutex mutex;
+	std::deque<std::string> lines;
+	bool closed = false;
+};
+
+static void read_lines(const std::shared_ptr<LineReader> reader)
+{
+	char line[128];
+	while (fgets(line, sizeof(line), stdin))
+	{
+		std::lock_guard<std::mutex> lock(reader->mutex);
+		reader->lines.push_back(line);
+	}
+	std::lock_guard<std::mutex> lock(reader->mutex);
+	reader->closed = true;
+}
+
+Debugger::Debugger(const size_t memory_size)
+	: breakpoints(memory_size), read_watchpoints(memory_size), write_watchpoints(memory_size)
+{
+	memset(previous_V, 0, sizeof(previous_V));
+}
+
+void Debugger::attach()
+{
+	attached = true;
+	paused = true;
+	prompt_shown = false;
+	if (!input)
+	{
+		input = std::make_shared<LineReader>();
+		std::thread(read_lines, input).detach();
+	}
+	else
+	{
+		// Whatever was typed while detached wasn't meant for this session
+		std::lock_guard<std::mutex> lock(input->mutex);
+		input->lines.clear();
+	}
+	printf("Debugger attached, type 'h' in the console for help\n");
+}
+
+void Debugger::detach()
+{
+	attached = false;
+	paused = false;
+	prompt_shown = false;
+	step_over_active = false;
+	printf("Debugger detached\n");
+}
+
+bool Debugger::before_cycle(WorkingChip8 &working_chip)
+{
+	const uint16_t PC = working_chip.chip->registers.PC;
+
+	// Fx0A keeps the PC in place until a key is pressed, don't break on the same instruction every frame.
+	// The same goes for every call while we are already stopped here waiting for a command.
+	if (!working_chip.waiting_for_input && !prompt_shown)
+	{
+		if (step_over_active && PC == step_over_PC && working_chip.chip->registers.SP == step_over_SP)
+		{
+			step_over_active = false;
+			paused = true;
+		}
+		if (breakpoints.test(PC))
+		{
+			printf("Breakpoint %03X\n", PC);
+			paused = true;
+		}
+	}
+
+	if (paused)
+	{
+		if (!prompt_shown)
+		{
+			print_disassembly(working_chip, PC, 1);
+			printf("(chip8) ");
+			fflush(stdout);
+			prompt_shown = true;
+		}
+		if (!poll_commands(working_chip)) return false;
+		prompt_shown = false;
+		if (working_chip.halted) return false;
+	}
+
+	if (trace)
+	{
+		char text[32];
+		disassemble(read_instruction(working_chip, PC), text, sizeof(text));
+		printf("%03X: %s\n", PC, text);
+	}
+
+	if (!register_conditions.empty())
+	{
+		memcpy(previous_V, working_chip.chip->registers.V, sizeof(previous_V));
+	}
+	return true;
+}
+
+void Debugger::after_cycle(WorkingChip8 &working_chip)
+{
+	for (const RegisterCondition &condition : register_conditions)
+	{
+		uint8_t value = working_chip.chip->registers.V[condition.register_index];
+		if (value == previous_V[condition.register_index]) continue;
+		if (condition.has_value && value != condition.value) continue;
+		printf("V%X changed %02X -> %02X\n", condition.register_index, previous_V[condition.register_index], value);
+		paused = true;
+	}
+}
+
+void Debugger::watch_hit(const uint16_t addr, const uint16_t length, const char *const kind)
+{
+	printf("Watchpoint %s %03X-%03X\n", kind, addr, addr + length - 1);
+	paused = true;
+}
+
+void Debugger::print_registers(const WorkingChip8 &working_chip) const
+{
+	const Chip8::Registers &registers = working_chip.chip->registers;
+	for (unsigned int i = 0; i < registers.Vregister_count; i++)
+	{
+		printf("V%X=%02X%c", i, registers.V[i], i % 8 == 7 ? '\n' : ' ');
+	}
+	printf("I=%03X PC=%03X SP=%X DT=%02X ST=%02X cycle %lu\n", registers.I, registers.PC, registers.SP, registers.DT, registers.ST, working_chip.cycle_count);
+}
+
+void Debugger::print_disassembly(const WorkingChip8 &working_chip, uint16_t addr, const unsigned int count) const
+{
+	for (unsigned int i = 0; i < count && addr + 1u < working_chip.chip->memory.size; i++, addr += 2)
+	{
+		char text[32];
+		uint16_t inst = read_instruction(working_chip, addr);
+		disassemble(inst, text, sizeof(text));
+		printf("%c%c %03X: %04X  %s\n", addr == working_chip.chip->registers.PC ? '>' : ' ', breakpoints.test(addr) ? '*' : ' ', addr, inst, text);
+	}
+}
+
+void Debugger::print_memory(const WorkingChip8 &working_chip, uint16_t addr, const unsigned int count) const
+{
+	for (unsigned int i = 0; i < count && addr < working_chip.chip->memory.size; i++, addr++)
+	{
+		if (i % 16 == 0) printf("%s%03X:", i == 0 ? "" : "\n", addr);
+		printf(" %02X", working_chip.chip->memory.data[addr]);
+	}
+	printf("\n");
+}
+
+bool Debugger::poll_commands(WorkingChip8 &working_chip)
+{
+	while (true)
+	{
+		std::string line;
+		{
+			std::lock_guard<std::mutex> lock(input->mutex);
+			if (input->lines.empty())
+			{
+				if (!input->closed) return false;
+				// Stdin was closed, nobody can resume anymore
+				detach();
+				return true;
+			}
+			line = input->lines.front();
+			input->lines.pop_front();
+		}
+
+		if (run_command(working_chip, line.c_str())) return true;
+		printf("(chip8) ");
+		fflush(stdout);
+	}
+}
+
+bool Debugger::run_command(WorkingChip8 &working_chip, const char *const line)
+{
+	char words[4][16] = { { 0 } };
+	int arg_count = split_words(line, words, 4) - 1;
+	if (arg_count < 0) return false;
+	const char *const command = words[0];
+	const char *const arg1 = words[1];
+	const char *const arg2 = words[2];
+	const char *const arg3 = words[3];
+
+	uint16_t addr = static_cast<uint16_t>(strtoul(arg1, nullptr, 16));
+	if (strcmp(command, "c") == 0)
+	{
+		paused = false;
+		return true;
+	}
+	else if (strcmp(command, "s") == 0)
+	{
+		paused = true;
+		return true;
+	}
+	else if (strcmp(command, "n") == 0)
+	{
+		// Step over calls by breaking when we are back behind the 2NNN at the same stack depth
+		if ((read_instruction(working_chip, working_chip.chip->registers.PC) & 0xF000) == 0x2000)
+		{
+			step_over_active = true;
+			step_over_PC = working_chip.chip->registers.PC + 2;
+			step_over_SP = working_chip.chip->registers.SP;
+			paused = false;
+		}
+		else
+		{
+			paused = true;
+		}
+		return true;
+	}
+	else if ((strcmp(command, "b") == 0 || strcmp(command, "bd") == 0) && arg_count >= 1)
+	{
+		breakpoints.set(addr, command[1] != 'd');
+	}
+	else if ((strcmp(command, "w") == 0 || strcmp(command, "wd") == 0) && arg_count >= 1)
+	{
+		uint16_t length = arg_count >= 2 ? static_cast<uint16_t>(strtoul(arg2, nullptr, 16)) : 1;
+		const char *kind = arg_count >= 3 ? arg3 : "rw";
+		bool value = command[1] != 'd';
+		for (uint16_t i = 0; i < length; i++)
+		{
+			if (strchr(kind, 'r')) read_watchpoints.set(addr + i, value);
+			if (strchr(kind, 'w')) write_watchpoints.set(addr + i, value);
+		}
+	}
+	else if ((strcmp(command, "cond") == 0 || strcmp(command, "condd") == 0) && arg_count >= 1 && (arg1[0] == 'V' || arg1[0] == 'v'))
+	{
+		uint8_t register_index = static_cast<uint8_t>(strtoul(arg1 + 1, nullptr, 16) & 0xF);
+		for (size_t i = 0; i < register_conditions.size(); i++)
+		{
+			if (register_conditions[i].register_index == register_index)
+			{
+				register_conditions.erase(register_conditions.begin() + i);
+				break;
+			}
+		}
+		if (strcmp(command, "cond") == 0)
+		{
+			register_conditions.push_back({ register_index, arg_count >= 2, static_cast<uint8_t>(strtoul(arg2, nullptr, 16)) });
+		}
+	}
+	else if (strcmp(command, "r") == 0)
+	{
+		print_registers(working_chip);
+	}
+	else if (strcmp(command, "dis") == 0)
+	{
+		uint16_t start = arg_count >= 1 ? addr : working_chip.chip->registers.PC;
+		unsigned int count = arg_count >= 2 ? static_cast<unsigned int>(strtoul(arg2, nullptr, 10)) : 10;
+		print_disassembly(working_chip, start, count);
+	}
+	else if (strcmp(command, "x") == 0 && arg_count >= 1)
+	{
+		unsigned int count = arg_count >= 2 ? static_cast<unsigned int>(strtoul(arg2, nullptr, 10)) : 16;
+		print_memory(working_chip, addr, count);
+	}
+	else if (strcmp(command, "trace") == 0)
+	{
+		trace = !trace;
+		printf("Trace %s\n", trace ? "on" : "off");
+	}
+	else if (strcmp(command, "halt") == 0)
+	{
+		working_chip.halted = true;
+		paused = false;
+		return true;
+	}
+	else if (strcmp(command, "q") == 0)
+	{
+		detach();
+		return true;
+	}
+	else
+	{
+		printf(
+			"c                   continue\n"
+			"s                   step\n"
+			"n                   step, stepping over 2NNN calls\n"
+			"b ADDR / bd ADDR    set / delete breakpoint\n"
+			"w ADDR [LEN] [r|w|rw] / wd ...  set / delete watchpoint on I relative accesses\n"
+			"cond Vx [VALUE]     break when Vx changes (to VALUE)\n"
+			"condd Vx            delete register condition\n"
+			"r                   show registers\n"
+			"dis [ADDR] [COUNT]  disassemble\n"
+			"x ADDR [COUNT]      dump memory\n"
+			"trace               toggle instruction trace\n"
+			"halt                halt the emulator\n"
+			"q                   detach the debugger\n"
+			"Addresses and values are hex, counts are decimal\n"
+		);
+	}
+	return false;
+}
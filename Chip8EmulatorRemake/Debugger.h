@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cinttypes>
+#include <memory>
+#include <vector>
+#include "WorkingChip8.h"
+
+// One bit per address
+struct AddressBitmap
+{
+	std::vector<uint8_t> bits;
+	AddressBitmap(const size_t size)
+		: bits((size + 7) / 8, 0)
+	{}
+
+	inline bool test(const uint16_t addr) const
+	{
+		return addr / 8u < bits.size() && (bits[addr / 8u] & (1 << (addr % 8u))) != 0;
+	}
+	inline bool test_range(const uint16_t addr, const uint16_t length) const
+	{
+		for (uint16_t i = 0; i < length; i++)
+		{
+			if (test(addr + i)) return true;
+		}
+		return false;
+	}
+	inline void set(const uint16_t addr, const bool value)
+	{
+		if (addr / 8u >= bits.size()) return;
+		if (value) bits[addr / 8u] |= (1 << (addr % 8u));
+		else bits[addr / 8u] &= ~(1 << (addr % 8u));
+	}
+};
+
+struct LineReader;
+
+// Debug policy for WorkingChip8::run_cycle, controlled with commands on stdin.
+// Stdin is read on its own thread, while paused run_cycle returns without executing so the caller's loop keeps going.
+struct Debugger
+{
+	// While detached the emulator should use the plain run_cycle
+	bool attached = false;
+	// Break before the next instruction
+	bool paused = false;
+	// Print every executed instruction
+	bool trace = false;
+
+	Debugger(const size_t memory_size);
+
+	void attach();
+	void detach();
+
+	bool before_cycle(WorkingChip8 &working_chip);
+	void after_cycle(WorkingChip8 &working_chip);
+
+	inline void on_read(const uint16_t addr, const uint16_t length)
+	{
+		if (read_watchpoints.test_range(addr, length)) watch_hit(addr, length, "read");
+	}
+	inline void on_write(const uint16_t addr, const uint16_t length)
+	{
+		if (write_watchpoints.test_range(addr, length)) watch_hit(addr, length, "write");
+	}
+
+private:
+	AddressBitmap breakpoints;
+	AddressBitmap read_watchpoints;
+	AddressBitmap write_watchpoints;
+
+	struct RegisterCondition
+	{
+		uint8_t register_index;
+		// Without a value any change of the register breaks
+		bool has_value;
+		uint8_t value;
+	};
+	std::vector<RegisterCondition> register_conditions;
+	uint8_t previous_V[Chip8::Registers::Vregister_count];
+
+	// Temporary breakpoint used by step over, only hit at the same stack depth
+	bool step_over_active = false;
+	uint16_t step_over_PC = 0;
+	uint8_t step_over_SP = 0;
+
+	std::shared_ptr<LineReader> input;
+	// The prompt for the current pause was printed
+	bool prompt_shown = false;
+
+	void watch_hit(const uint16_t addr, const uint16_t length, const char *const kind);
+	// Runs the commands typed so far, returns true once one of them resumes execution
+	bool poll_commands(WorkingChip8 &working_chip);
+	// Returns true if the command resumes execution
+	bool run_command(WorkingChip8 &working_chip, const char *const line);
+	void print_registers(const WorkingChip8 &working_chip) const;
+	void print_disassembly(const WorkingChip8 &working_chip, uint16_t addr, const unsigned int count) const;
+	void print_memory(const WorkingChip8 &working_chip, uint16_t addr, const unsigned int count) const;
+};
@@ -0,0 +1,77 @@
+#include "Disassembler.h"
+#include "WorkingChip8.h"
+#include <cstdio>
+
+void disassemble(const uint16_t inst, char *const buffer, const size_t buffer_size)
+{
+	uint16_t nnn = inst & 0x0FFF;
+	uint8_t kk = inst & 0x00FF;
+	uint8_t n = inst & 0x000F;
+	uint8_t x = get_nibble<uint8_t>(inst, 0x0F00, 2);
+	uint8_t y = get_nibble<uint8_t>(inst, 0x00F0, 1);
+
+	switch (get_nibble<uint8_t>(inst, 0xF000, 3)) {
+		case 0x0:
+		{
+			switch (kk) {
+				case 0xE0: snprintf(buffer, buffer_size, "CLS"); return;
+				case 0xEE: snprintf(buffer, buffer_size, "RET"); return;
+				case 0xFD: snprintf(buffer, buffer_size, "EXIT"); return;
+			}
+		} break;
+		case 0x1: snprintf(buffer, buffer_size, "JP %03X", nnn); return;
+		case 0x2: snprintf(buffer, buffer_size, "CALL %03X", nnn); return;
+		case 0x3: snprintf(buffer, buffer_size, "SE V%X, %02X", x, kk); return;
+		case 0x4: snprintf(buffer, buffer_size, "SNE V%X, %02X", x, kk); return;
+		case 0x5:
+		{
+			if (n == 0x0) { snprintf(buffer, buffer_size, "SE V%X, V%X", x, y); return; }
+		} break;
+		case 0x6: snprintf(buffer, buffer_size, "LD V%X, %02X", x, kk); return;
+		case 0x7: snprintf(buffer, buffer_size, "ADD V%X, %02X", x, kk); return;
+		case 0x8:
+		{
+			switch (n) {
+				case 0x0: snprintf(buffer, buffer_size, "LD V%X, V%X", x, y); return;
+				case 0x1: snprintf(buffer, buffer_size, "OR V%X, V%X", x, y); return;
+				case 0x2: snprintf(buffer, buffer_size, "AND V%X, V%X", x, y); return;
+				case 0x3: snprintf(buffer, buffer_size, "XOR V%X, V%X", x, y); return;
+				case 0x4: snprintf(buffer, buffer_size, "ADD V%X, V%X", x, y); return;
+				case 0x5: snprintf(buffer, buffer_size, "SUB V%X, V%X", x, y); return;
+				case 0x6: snprintf(buffer, buffer_size, "SHR V%X", x); return;
+				case 0x7: snprintf(buffer, buffer_size, "SUBN V%X, V%X", x, y); return;
+				case 0xE: snprintf(buffer, buffer_size, "SHL V%X", x); return;
+			}
+		} break;
+		case 0x9:
+		{
+			if (n == 0x0) { snprintf(buffer, buffer_size, "SNE V%X, V%X", x, y); return; }
+		} break;
+		case 0xA: snprintf(buffer, buffer_size, "LD I, %03X", nnn); return;
+		case 0xB: snprintf(buffer, buffer_size, "JP V0, %03X", nnn); return;
+		case 0xC: snprintf(buffer, buffer_size, "RND V%X, %02X", x, kk); return;
+		case 0xD: snprintf(buffer, buffer_size, "DRW V%X, V%X, %X", x, y, n); return;
+		case 0xE:
+		{
+			switch (kk) {
+				case 0x9E: snprintf(buffer, buffer_size, "SKP V%X", x); return;
+				case 0xA1: snprintf(buffer, buffer_size, "SKNP V%X", x); return;
+			}
+		} break;
+		case 0xF:
+		{
+			switch (kk) {
+				case 0x07: snprintf(buffer, buffer_size, "LD V%X, DT", x); return;
+				case 0x0A: snprintf(buffer, buffer_size, "LD V%X, K", x); return;
+				case 0x15: snprintf(buffer, buffer_size, "LD DT, V%X", x); return;
+				case 0x18: snprintf(buffer, buffer_size, "LD ST, V%X", x); return;
+				case 0x1E: snprintf(buffer, buffer_size, "ADD I, V%X", x); return;
+				case 0x29: snprintf(buffer, buffer_size, "LD F, V%X", x); return;
+				case 0x33: snprintf(buffer, buffer_size, "LD B, V%X", x); return;
+				case 0x55: snprintf(buffer, buffer_size, "LD [I], V%X", x); return;
+				case 0x65: snprintf(buffer, buffer_size, "LD V%X, [I]", x); return;
+			}
+		} break;
+	}
+	snprintf(buffer, buffer_size, "DW %04X", inst);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+// Writes the mnemonic for inst into buffer, unknown instructions are written as a raw data word
+void disassemble(const uint16_t inst, char *const buffer, const size_t buffer_size);
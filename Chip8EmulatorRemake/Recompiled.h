@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+#include "WorkingChip8.h"
+
+// A ROM compiled ahead of time by Chip8Recompiler
+struct RecompiledProgram
+{
+	// The ROM the program was compiled from, a block only runs while memory still holds its bytes
+	const uint8_t *rom;
+	size_t rom_size;
+	// Runs compiled blocks from PC for at most max_cycles instructions, going straight from one block to the next.
+	// Returns to the caller at instructions left to the interpreter, at changed code and before a key check that isn't the first instruction.
+	// Returns the number of instructions run, 0 when there is no block at PC that could run.
+	unsigned long (*run)(WorkingChip8 &working_chip, const unsigned long max_cycles);
+};
+
+// Generated files register their program during static initialization
+void register_recompiled_program(const RecompiledProgram &program);
+// Returns the registered program compiled from exactly these ROM bytes, or null
+const RecompiledProgram *find_recompiled_program(const uint8_t *const rom, const size_t rom_size);
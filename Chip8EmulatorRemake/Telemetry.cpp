@@ -0,0 +1,139 @@
+#include "Telemetry.h"
+
+Histogram::Histogram()
+{
+	reset();
+}
+
+void Histogram::record(const uint64_t value)
+{
+	size_t bucket = 0;
+	for (uint64_t v = value; v != 0 && bucket < bucket_count - 1; v >>= 1) bucket++;
+	buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(value, std::memory_order_relaxed);
+
+	uint64_t current_max = max.load(std::memory_order_relaxed);
+	while (value > current_max && !max.compare_exchange_weak(current_max, value, std::memory_order_relaxed));
+}
+
+void Histogram::reset()
+{
+	for (size_t i = 0; i < bucket_count; i++)
+	{
+		buckets[i].store(0, std::memory_order_relaxed);
+	}
+	count.store(0, std::memory_order_relaxed);
+	sum.store(0, std::memory_order_relaxed);
+	max.store(0, std::memory_order_relaxed);
+}
+
+double Histogram::mean() const
+{
+	uint64_t n = count.load(std::memory_order_relaxed);
+	return n == 0 ? 0 : static_cast<double>(sum.load(std::memory_order_relaxed)) / n;
+}
+
+uint64_t Histogram::percentile(const double fraction) const
+{
+	uint64_t n = count.load(std::memory_order_relaxed);
+	uint64_t target = static_cast<uint64_t>(n * fraction);
+	uint64_t seen = 0;
+	uint64_t upper_bound = 1;
+	for (size_t i = 0; i < bucket_count; i++)
+	{
+		seen += buckets[i].load(std::memory_order_relaxed);
+		if (seen > target) break;
+		upper_bound <<= 1;
+	}
+	uint64_t largest = max.load(std::memory_order_relaxed);
+	return upper_bound < largest ? upper_bound : largest;
+}
+
+void Histogram::write_json(FILE *const file) const
+{
+	fprintf(file, "{\"count\":%llu,\"mean\":%.1f,\"p50\":%llu,\"p99\":%llu,\"max\":%llu,\"buckets\":[",
+		static_cast<unsigned long long>(count.load(std::memory_order_relaxed)), mean(),
+		static_cast<unsigned long long>(percentile(0.5)), static_cast<unsigned long long>(percentile(0.99)),
+		static_cast<unsigned long long>(max.load(std::memory_order_relaxed)));
+	for (size_t i = 0; i < bucket_count; i++)
+	{
+		fprintf(file, "%s%llu", i == 0 ? "" : ",", static_cast<unsigned long long>(buckets[i].load(std::memory_order_relaxed)));
+	}
+	fprintf(file, "]}");
+}
+
+Telemetry::Telemetry(const char *const log_path, const double report_interval_seconds)
+	: start_time(std::chrono::steady_clock::now()), report_interval(static_cast<uint64_t>(report_interval_seconds * 1000000)), log_path(log_path)
+{
+	instructions.store(0, std::memory_order_relaxed);
+}
+
+Telemetry::~Telemetry()
+{
+	if (log_file) fclose(log_file);
+}
+
+uint64_t Telemetry::now() const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void Telemetry::tick()
+{
+	uint64_t time = now();
+	if (time - last_report_time < report_interval) return;
+
+	double elapsed_seconds = (time - last_report_time) / 1000000.0;
+	report.instructions_per_second = instructions.load(std::memory_order_relaxed) / elapsed_seconds;
+	report.frame_time_mean = frame_time.mean();
+	report.frame_time_p99 = frame_time.percentile(0.99);
+	report.emulation_time_mean = emulation_time.mean();
+	report.render_time_mean = render_time.mean();
+	report.event_time_mean = event_time.mean();
+	report.lag_p99 = lag.percentile(0.99);
+	report.sequence++;
+
+	write_log_line(time, elapsed_seconds);
+	reset();
+	last_report_time = time;
+}
+
+void Telemetry::write_log_line(const uint64_t time, const double elapsed_seconds)
+{
+	if (!log_path) return;
+	if (!log_file)
+	{
+#ifdef _MSC_VER
+		if (fopen_s(&log_file, log_path, "a") != 0) log_file = nullptr;
+#else
+		log_file = fopen(log_path, "a");
+#endif
+		if (!log_file)
+		{
+			printf("Couldn't open telemetry log '%s'\n", log_path);
+			return;
+		}
+	}
+
+	fprintf(log_file, "{\"time\":%.3f,\"interval\":%.3f,\"ips\":%.1f", time / 1000000.0, elapsed_seconds, report.instructions_per_second);
+	const Histogram *histograms[] = { &frame_time, &emulation_time, &render_time, &event_time, &lag };
+	const char *names[] = { "frame_time", "emulation_time", "render_time", "event_time", "lag" };
+	for (size_t i = 0; i < sizeof(histograms) / sizeof(*histograms); i++)
+	{
+		fprintf(log_file, ",\"%s\":", names[i]);
+		histograms[i]->write_json(log_file);
+	}
+	fprintf(log_file, "}\n");
+	fflush(log_file);
+}
+
+void Telemetry::reset()
+{
+	frame_time.reset();
+	emulation_time.reset();
+	render_time.reset();
+	event_time.reset();
+	lag.reset();
+	instructions.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+
+// Histogram of microsecond samples with fixed power of two buckets.
+// Bucket 0 holds samples below 1us, bucket i holds [2^(i-1), 2^i) and the last one everything above.
+struct Histogram
+{
+	static const size_t bucket_count = 24;
+	std::atomic<uint64_t> buckets[bucket_count];
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> sum;
+	std::atomic<uint64_t> max;
+
+	Histogram();
+
+	void record(const uint64_t value);
+	void reset();
+
+	double mean() const;
+	// Upper bound of the bucket the percentile falls in, capped at the largest sample
+	uint64_t percentile(const double fraction) const;
+	void write_json(FILE *const file) const;
+};
+
+struct TelemetryReport
+{
+	double instructions_per_second = 0;
+	double frame_time_mean = 0;
+	uint64_t frame_time_p99 = 0;
+	double emulation_time_mean = 0;
+	double render_time_mean = 0;
+	double event_time_mean = 0;
+	uint64_t lag_p99 = 0;
+	// Incremented every time the report is updated
+	unsigned int sequence = 0;
+};
+
+// Timing of the main loop, all times in microseconds
+struct Telemetry
+{
+	Histogram frame_time;
+	Histogram emulation_time;
+	Histogram render_time;
+	Histogram event_time;
+	// How far behind the target frame schedule a frame started
+	Histogram lag;
+	std::atomic<uint64_t> instructions;
+
+	bool overlay = false;
+	TelemetryReport report;
+
+	// log_path can be null to only keep the report for the overlay
+	Telemetry(const char *const log_path, const double report_interval_seconds);
+	~Telemetry();
+
+	uint64_t now() const;
+	inline void add_instructions(const uint64_t count)
+	{
+		instructions.fetch_add(count, std::memory_order_relaxed);
+	}
+	// Call once per frame, updates the report and writes a log line when the interval has passed
+	void tick();
+
+private:
+	const std::chrono::steady_clock::time_point start_time;
+	const uint64_t report_interval;
+	uint64_t last_report_time = 0;
+
+	const char *const log_path;
+	FILE *log_file = nullptr;
+
+	void write_log_line(const uint64_t time, const double elapsed_seconds);
+	void reset();
+};
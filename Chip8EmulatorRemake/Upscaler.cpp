@@ -0,0 +1,253 @@
+#include "Upscaler.h"
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UPSCALER_SSE2
+#include <emmintrin.h>
+#endif
+
+const char *get_filter_name(const UpscaleFilter filter)
+{
+	switch (filter) {
+		case UpscaleFilter::Nearest: return "Nearest";
+		case UpscaleFilter::Scale2x: return "Scale2x";
+		case UpscaleFilter::Scanlines: return "Scanlines";
+	}
+	return "Unknown";
+}
+
+Upscaler::Upscaler(const size_t width, const size_t height)
+	: width(width), height(height), padded_width(width + 2),
+	  intensity(new uint8_t[(width + 2) * (height + 2)]()), scaled(new uint8_t[width * 2 * height * 2]())
+{
+	set_colors({ 0x66, 0xFF, 0x66, 0xFF }, { 0x00, 0x00, 0x00, 0xFF });
+}
+
+Upscaler::~Upscaler()
+{
+	delete[] intensity;
+	delete[] scaled;
+	delete[] x_map;
+	delete[] row_buffers[0];
+	delete[] row_buffers[1];
+}
+
+void Upscaler::release()
+{
+	SDL_DestroyTexture(texture);
+	texture = nullptr;
+	texture_width = 0;
+	texture_height = 0;
+}
+
+void Upscaler::set_persistence(const uint8_t persistence)
+{
+	this->persistence = persistence;
+}
+
+void Upscaler::set_colors(const SDL_Color on_color, const SDL_Color off_color)
+{
+	for (unsigned int i = 0; i < 256; i++)
+	{
+		uint8_t r = static_cast<uint8_t>(off_color.r + (on_color.r - off_color.r) * static_cast<int>(i) / 255);
+		uint8_t g = static_cast<uint8_t>(off_color.g + (on_color.g - off_color.g) * static_cast<int>(i) / 255);
+		uint8_t b = static_cast<uint8_t>(off_color.b + (on_color.b - off_color.b) * static_cast<int>(i) / 255);
+		palette[i] = 0xFF000000 | (r << 16) | (g << 8) | b;
+		// Scanlines are drawn at 60% brightness
+		dark_palette[i] = 0xFF000000 | ((r * 3 / 5) << 16) | ((g * 3 / 5) << 8) | (b * 3 / 5);
+	}
+}
+
+uint8_t *Upscaler::get_intensity_row(const size_t y) const
+{
+	return intensity + (y + 1) * padded_width + 1;
+}
+
+void Upscaler::update(const Chip8::Screen &screen)
+{
+	for (size_t y = 0; y < height; y++)
+	{
+		const uint8_t *src = screen.data + y * width;
+		uint8_t *dst = get_intensity_row(y);
+		size_t x = 0;
+#ifdef UPSCALER_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i factor = _mm_set1_epi16(persistence);
+		for (; x + 16 <= width; x += 16)
+		{
+			// Lit pixels go to full intensity, everything else decays by persistence / 256
+			__m128i lit = _mm_cmpgt_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x)), zero);
+			__m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + x));
+			__m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(current, zero), factor), 8);
+			__m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(current, zero), factor), 8);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_or_si128(lit, _mm_packus_epi16(lo, hi)));
+		}
+#endif
+		for (; x < width; x++)
+		{
+			dst[x] = src[x] ? 0xFF : static_cast<uint8_t>((dst[x] * persistence) >> 8);
+		}
+	}
+	update_border();
+}
+
+void Upscaler::update_border()
+{
+	// Clamp to the edge so scale2x sees the edge pixels as their own neighbours
+	for (size_t y = 0; y < height; y++)
+	{
+		uint8_t *row = get_intensity_row(y);
+		row[-1] = row[0];
+		row[width] = row[width - 1];
+	}
+	memcpy(intensity, intensity + padded_width, padded_width);
+	memcpy(intensity + (height + 1) * padded_width, intensity + height * padded_width, padded_width);
+}
+
+void Upscaler::run_scale2x()
+{
+	const size_t scaled_width = width * 2;
+	for (size_t y = 0; y < height; y++)
+	{
+		const uint8_t *row = get_intensity_row(y);
+		const uint8_t *above = row - padded_width;
+		const uint8_t *below = row + padded_width;
+		uint8_t *out_top = scaled + (y * 2) * scaled_width;
+		uint8_t *out_bottom = out_top + scaled_width;
+		size_t x = 0;
+#ifdef UPSCALER_SSE2
+		for (; x + 16 <= width; x += 16)
+		{
+			//   B
+			// D E F
+			//   H
+			__m128i B = _mm_loadu_si128(reinterpret_cast<const __m128i *>(above + x));
+			__m128i D = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x - 1));
+			__m128i E = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+			__m128i F = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x + 1));
+			__m128i H = _mm_loadu_si128(reinterpret_cast<const __m128i *>(below + x));
+
+			__m128i DB = _mm_cmpeq_epi8(D, B);
+			__m128i BF = _mm_cmpeq_epi8(B, F);
+			__m128i DH = _mm_cmpeq_epi8(D, H);
+			__m128i HF = _mm_cmpeq_epi8(H, F);
+
+			__m128i mask0 = _mm_andnot_si128(_mm_or_si128(BF, DH), DB);
+			__m128i mask1 = _mm_andnot_si128(_mm_or_si128(DB, HF), BF);
+			__m128i mask2 = _mm_andnot_si128(_mm_or_si128(DB, HF), DH);
+			__m128i mask3 = _mm_andnot_si128(_mm_or_si128(DH, BF), HF);
+
+			__m128i E0 = _mm_or_si128(_mm_and_si128(mask0, D), _mm_andnot_si128(mask0, E));
+			__m128i E1 = _mm_or_si128(_mm_and_si128(mask1, F), _mm_andnot_si128(mask1, E));
+			__m128i E2 = _mm_or_si128(_mm_and_si128(mask2, D), _mm_andnot_si128(mask2, E));
+			__m128i E3 = _mm_or_si128(_mm_and_si128(mask3, F), _mm_andnot_si128(mask3, E));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out_top + x * 2), _mm_unpacklo_epi8(E0, E1));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out_top + x * 2 + 16), _mm_unpackhi_epi8(E0, E1));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out_bottom + x * 2), _mm_unpacklo_epi8(E2, E3));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out_bottom + x * 2 + 16), _mm_unpackhi_epi8(E2, E3));
+		}
+#endif
+		for (; x < width; x++)
+		{
+			uint8_t B = above[x];
+			uint8_t D = row[x - 1];
+			uint8_t E = row[x];
+			uint8_t F = row[x + 1];
+			uint8_t H = below[x];
+			out_top[x * 2] = (D == B && B != F && D != H) ? D : E;
+			out_top[x * 2 + 1] = (B == F && B != D && F != H) ? F : E;
+			out_bottom[x * 2] = (D == H && D != B && H != F) ? D : E;
+			out_bottom[x * 2 + 1] = (H == F && D != H && B != F) ? F : E;
+		}
+	}
+}
+
+void Upscaler::resize(SDL_Renderer *const renderer, const int output_width, const int output_height)
+{
+	SDL_DestroyTexture(texture);
+	delete[] x_map;
+	delete[] row_buffers[0];
+	delete[] row_buffers[1];
+
+	texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, output_width, output_height);
+	if (!texture)
+	{
+		printf("Upscaler texture could not be created! SDL_Error: %s\n", SDL_GetError());
+	}
+	texture_width = output_width;
+	texture_height = output_height;
+
+	x_map = new size_t[output_width];
+	row_buffers[0] = new uint32_t[output_width];
+	row_buffers[1] = new uint32_t[output_width];
+}
+
+void Upscaler::build_row(uint32_t *const row, const uint8_t *const source_row, const uint32_t *const row_palette) const
+{
+	for (int x = 0; x < texture_width; x++)
+	{
+		row[x] = row_palette[source_row[x_map[x]]];
+	}
+}
+
+void Upscaler::draw(SDL_Renderer *const renderer, const SDL_Rect &dest)
+{
+	if (dest.w <= 0 || dest.h <= 0) return;
+	if (!texture || texture_width != dest.w || texture_height != dest.h)
+	{
+		resize(renderer, dest.w, dest.h);
+	}
+	if (!texture) return;
+
+	const uint8_t *source;
+	size_t source_width;
+	size_t source_height;
+	size_t source_stride;
+	if (filter == UpscaleFilter::Scale2x)
+	{
+		run_scale2x();
+		source = scaled;
+		source_width = width * 2;
+		source_height = height * 2;
+		source_stride = source_width;
+	}
+	else
+	{
+		source = get_intensity_row(0);
+		source_width = width;
+		source_height = height;
+		source_stride = padded_width;
+	}
+
+	for (int x = 0; x < texture_width; x++)
+	{
+		x_map[x] = x * source_width / texture_width;
+	}
+
+	void *pixels;
+	int pitch;
+	if (SDL_LockTexture(texture, nullptr, &pixels, &pitch) < 0)
+	{
+		printf("Upscaler texture could not be locked! SDL_Error: %s\n", SDL_GetError());
+		return;
+	}
+
+	// Only build each distinct row once, the rest are plain copies
+	size_t built_rows[2] = { SIZE_MAX, SIZE_MAX };
+	for (int y = 0; y < texture_height; y++)
+	{
+		size_t source_y = y * source_height / texture_height;
+		int dark = (filter == UpscaleFilter::Scanlines && (y & 1)) ? 1 : 0;
+		if (built_rows[dark] != source_y)
+		{
+			build_row(row_buffers[dark], source + source_y * source_stride, dark ? dark_palette : palette);
+			built_rows[dark] = source_y;
+		}
+		memcpy(static_cast<uint8_t *>(pixels) + y * pitch, row_buffers[dark], texture_width * sizeof(uint32_t));
+	}
+
+	SDL_UnlockTexture(texture);
+	SDL_RenderCopy(renderer, texture, nullptr, &dest);
+}
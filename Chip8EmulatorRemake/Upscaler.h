@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cinttypes>
+#include <SDL.h>
+#include "Chip8.h"
+
+enum class UpscaleFilter
+{
+	Nearest,
+	Scale2x,
+	Scanlines,
+};
+
+const char *get_filter_name(const UpscaleFilter filter);
+
+// Software post-processing of the chip8 screen.
+// Keeps a decaying intensity per pixel so XOR flicker fades instead of blinking,
+// then scales it up to the output size straight into a streaming texture.
+struct Upscaler
+{
+	UpscaleFilter filter = UpscaleFilter::Nearest;
+
+	const size_t width;
+	const size_t height;
+
+	Upscaler(const size_t width, const size_t height);
+	~Upscaler();
+	// Destroys the texture, call before the renderer is destroyed. The next draw creates a new one
+	void release();
+
+	// persistence is how much of a pixel is left after one frame, 0 = no persistence, 255 = (almost) never fades
+	void set_persistence(const uint8_t persistence);
+	void set_colors(const SDL_Color on_color, const SDL_Color off_color);
+
+	// Call once per frame, even when nothing was drawn so switched off pixels keep fading
+	void update(const Chip8::Screen &screen);
+	void draw(SDL_Renderer *const renderer, const SDL_Rect &dest);
+
+private:
+	uint8_t persistence = 0;
+
+	// Intensities with a 1 pixel border around them so scale2x can read its neighbours without bounds checks
+	const size_t padded_width;
+	uint8_t *const intensity;
+	// Scale2x output, 2 * width by 2 * height
+	uint8_t *const scaled;
+
+	uint32_t palette[256];
+	uint32_t dark_palette[256];
+
+	SDL_Texture *texture = nullptr;
+	int texture_width = 0;
+	int texture_height = 0;
+	// Source column for every output column
+	size_t *x_map = nullptr;
+	// One prepared output row per palette, rows that map to the same source row get copied from here
+	uint32_t *row_buffers[2] = { nullptr, nullptr };
+
+	uint8_t *get_intensity_row(const size_t y) const;
+	void update_border();
+	void run_scale2x();
+	void resize(SDL_Renderer *const renderer, const int output_width, const int output_height);
+	void build_row(uint32_t *const row, const uint8_t *const source_row, const uint32_t *const row_palette) const;
+};
@@ -1,9 +1,12 @@
 #include "WorkingChip8.h"
+#include "WorkingChip8.inl"
+#include "Recompiled.h"
 #include <cstdio>
 #include <cstdlib>
 #include <cinttypes>
 #include <ctime>
 #include <cstring>
+#include <vector>
 
 WorkingChip8::WorkingChip8(Chip8 *const chip)
 	: chip(chip)
@@ -16,8 +19,14 @@ WorkingChip8::WorkingChip8(Chip8 *const chip)
 
 void WorkingChip8::load_program(const uint8_t *const data, const size_t data_size)
 {
-	printf("Loading %zu bytes\n", data_size);
-	memcpy(chip->memory.data + 0x200, data, data_size);
+	size_t size = data_size;
+	if (size > chip->memory.size - 0x200)
+	{
+		printf("Program is %zu bytes, only loading the first %zu\n", data_size, chip->memory.size - 0x200);
+		size = chip->memory.size - 0x200;
+	}
+	printf("Loading %zu bytes\n", size);
+	memcpy(chip->memory.data + 0x200, data, size);
 }
 
 void WorkingChip8::reset()
@@ -58,289 +67,49 @@ uint16_t WorkingChip8::pop_stack()
 	return n;
 }
 
+template bool WorkingChip8::execute<NoDebugger>(const uint16_t inst, NoDebugger &debug);
+template void WorkingChip8::run_cycle<NoDebugger>(NoDebugger &debug);
+
 bool WorkingChip8::execute(const uint16_t inst)
 {
-	switch (get_nibble<uint8_t>(inst, 0xF000, 3)) {
-		case 0x0:
-		{
-			switch (inst & 0x00FF) {
-				case 0xE0:
-				{
-					for (unsigned int i = 0; i < chip->screen.width * chip->screen.height; i++) 
-					{
-						chip->screen.data[i] = 0;
-					}
-				} break;
-				case 0xEE:
-				{
-					chip->registers.PC = pop_stack();
-				} break;
-				case 0x00: // Halt in null memory
-				case 0xFD:
-				{
-					halted = true;
-				} break;
-				default: return false;
-			}
-		} break;
-		case 0x1:
-		{
-			uint16_t addr = inst & 0x0FFF;
-			chip->registers.PC = addr - 2;
-		} break;
-		case 0x2:
-		{
-			uint16_t addr = inst & 0x0FFF;
-			push_stack(chip->registers.PC);
-			chip->registers.PC = addr;
-		} break;
-		case 0x3:
-		{
-			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
-			uint16_t value = inst & 0x00FF;
-			if (chip->registers.V[register_index] == value) chip->registers.PC += 2;
-		} break;
-		case 0x4:
-		{
-			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
-			uint16_t value = inst & 0x00FF;
-			if (chip->registers.V[register_index] != value) chip->registers.PC += 2;
-		} break;
-		case 0x5:
-		{
-			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
-			uint8_t other_register_index = get_nibble<uint8_t>(inst, 0x00F0, 1);
-			if (chip->registers.V[register_index] == chip->registers.V[other_register_index]) chip->registers.PC += 2;
-		} break;
-		case 0x6:
-		{
-			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
-			uint8_t value = inst & 0x00FF;
-			chip->registers.V[register_index] = value;
-		} break;
-		case 0x7:
-		{
-			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
-			uint16_t value = inst & 0x00FF;
-			chip->registers.V[register_index] += value;
-		} break;
-		case 0x8:
-		{
-			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
-			uint8_t other_register_index = get_nibble<uint8_t>(inst, 0x00F0, 1);
-			switch (inst & 0x000F) {
-				case 0x0:
-				{
-					chip->registers.V[register_index] = chip->registers.V[other_register_index];
-				} break;
-				case 0x1:
-				{
-					chip->registers.V[register_index] |= chip->registers.V[other_register_index];
-				} break;
-				case 0x2:
-				{
-					chip->registers.V[register_index] &= chip->registers.V[other_register_index];
-				} break;
-				case 0x3:
-				{
-					chip->registers.V[register_index] ^= chip->registers.V[other_register_index];
-				} break;
-				case 0x4:
-				{
-					uint16_t res = chip->registers.V[register_index] + chip->registers.V[other_register_index];
-					chip->registers.VF = res > 0xFF ? 1 : 0;
-					chip->registers.V[register_index] = static_cast<uint8_t>(res & 0xFFFF);
-				} break;
-				case 0x5:
-				{
-					uint8_t Vx = chip->registers.V[register_index];
-					uint8_t Vy = chip->registers.V[other_register_index];
-					if (Vy > Vx) chip->registers.VF;
-					chip->registers.V[register_index] = Vx - Vy;
-				} break;
-				case 0x6:
-				{
-					chip->registers.VF = (chip->registers.V[register_index] & 1) != 0 ? 1 : 0;
-					chip->registers.V[register_index] >>= 1;
-				} break;
-				case 0x7:
-				{
-					uint8_t Vx = chip->registers.V[register_index];
-					uint8_t Vy = chip->registers.V[other_register_index];
-					if (Vy > Vx) chip->registers.VF;
-					chip->registers.V[register_index] = Vy - Vx;
-				} break;
-				case 0xE:
-				{
-					(chip->registers.VF = chip->registers.V[register_index] & (1 << 7)) != 0 ? 1 : 0;
-					chip->registers.V[register_index] <<= 1;
-				} break;
-				default: return false;
-			}
-		} break;
-		case 0x9:
-		{
-			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
-			uint8_t other_register_index = get_nibble<uint8_t>(inst, 0x00F0, 1);
-			if (chip->registers.V[register_index] != chip->registers.V[other_register_index]) chip->registers.PC++;
-		} break;
-		case 0xA:
-		{
-			uint16_t val = inst & 0x0FFF;
-			chip->registers.I = val;
-		} break;
-		case 0xB:
-		{
-			uint16_t addr = inst & 0x0FFF;
-			chip->registers.PC = chip->registers.V0 + addr;
-		} break;
-		case 0xC:
-		{
-			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
-			uint16_t value = inst & 0x00FF;
-			int n = rand() % 256;
-			chip->registers.V[register_index] += n & value;
-		} break;
-		case 0xD:
-		{
-			uint8_t pos_x = chip->registers.V[get_nibble<uint8_t>(inst, 0x0F00, 2)];
-			uint8_t pos_y = chip->registers.V[get_nibble<uint8_t>(inst, 0x00F0, 1)];
-			uint8_t n = inst & 0x000F;
-			chip->registers.VF = 0;
-			for (unsigned int y = 0; y < n; y++)
-			{
-				uint8_t pixel = chip->memory.data[chip->registers.I + y];
-				for (unsigned int x = 0; x < 8; x++)
-				{
-					if ((pixel & (0x80 >> x)) != 0) 
-					{
-						unsigned int index = ((pos_x + x) % chip->screen.width) + static_cast<unsigned int>(((pos_y + y) % chip->screen.height) * chip->screen.width);
-						chip->registers.VF = chip->screen.data[index];
-						chip->screen.data[index] ^= 1;
-					}
-				}
-			}
-			redraw = true;
-		} break;
-		case 0xE:
-		{
-			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
-			switch (inst & 0x00FF) {
-				case 0x9E:
-				{
-					uint8_t key = chip->registers.V[register_index];
-					if (chip->keyboard.data[key]) chip->registers.PC += 2;
-				} break;
-				case 0xA1:
-				{
-					uint8_t key = chip->registers.V[register_index];
-					if (!chip->keyboard.data[key]) chip->registers.PC += 2;
-				} break;
-				default: return false;
-			}
-		}
-		case 0xF:
-		{
-			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
-			switch (inst & 0x00FF) {
-				case 0x07:
-				{
-					chip->registers.V[register_index] = chip->registers.DT;
-				} break;
-				case 0x0A:
-				{
-					waiting_for_input = true;
-					for (int i = 0; i < chip->keyboard.size; i++)
-					{
-						if (chip->keyboard.data[i]) 
-						{
-							chip->registers.V[register_index] = i;
-							waiting_for_input = false;
-							break;
-						}
-					}
-				}
-				case 0x15:
-				{
-					chip->registers.DT = chip->registers.V[register_index];
-				} break;
-				case 0x18:
-				{
-					chip->registers.ST = chip->registers.V[register_index];
-				} break;
-				case 0x1E:
-				{
-					chip->registers.I += chip->registers.V[register_index];
-				} break;
-				case 0x29:
-				{
-					uint8_t key = chip->registers.V[register_index];
-					chip->registers.I = 0x50 + key * 5;
-				} break;
-				case 0x33:
-				{
-					chip->memory.data[chip->registers.I] = chip->registers.V[register_index] / 100;
-					chip->memory.data[chip->registers.I + 1] = chip->registers.V[register_index] / 10 % 100;
-					chip->memory.data[chip->registers.I + 2] = chip->registers.V[register_index] % 10;
-				} break;
-				case 0x55:
-				{
-					for (int i = 0; i <= register_index; i++) {
-						chip->memory.data[chip->registers.I + i] = chip->registers.V[i];
-					}
-				} break;
-				case 0x65:
-				{
-					for (int i = 0; i <= register_index; i++) {
-						chip->registers.V[i] = chip->memory.data[chip->registers.I + i];
-					}
-				} break;
-				default: return false;
-			}
-		} break;
-		default: return false;
-	}
-	return true;
+	NoDebugger debug;
+	return execute(inst, debug);
 }
 
 void WorkingChip8::run_cycle()
 {
-	uint16_t inst = ((uint16_t)chip->memory.data[chip->registers.PC] << 8) | chip->memory.data[chip->registers.PC + 1];
-	if (!execute(inst)) 
-	{
-		printf("Unknown opcode %04x cycle %d line %d PC %04x\n", inst, cycle_count, (chip->registers.PC - 0x200) / 2, chip->registers.PC);
-	}
-	else
-	{
-		printf("%04x line %d PC %04x\n", inst, (chip->registers.PC - 0x200) / 2, chip->registers.PC);
-	}
+	NoDebugger debug;
+	run_cycle(debug);
+}
 
-	if (waiting_for_input) return;
-	for (int i = 0; i < chip->keyboard.size; i++) {
-		chip->keyboard.data[i] = false;
-	}
+void WorkingChip8::run_recompiled(const RecompiledProgram &program, const unsigned long max_cycles)
+{
+	if (program.run(*this, max_cycles) == 0) run_cycle();
+}
 
-	chip->registers.PC += 2;
-	if (chip->registers.PC < 0x200) printf("Detected possible OOB code execution\n");
+// Function local so it exists before the static initializers of generated files register into it
+static std::vector<const RecompiledProgram *> &get_recompiled_programs()
+{
+	static std::vector<const RecompiledProgram *> programs;
+	return programs;
+}
 
-	cycle_count++;
+void register_recompiled_program(const RecompiledProgram &program)
+{
+	get_recompiled_programs().push_back(&program);
 }
 
-void WorkingChip8::draw(SDL_Renderer *const renderer, const unsigned int offsetX, const unsigned int offsetY, const int pixel_scale)
+const RecompiledProgram *find_recompiled_program(const uint8_t *const rom, const size_t rom_size)
 {
-	SDL_Rect *rects = new SDL_Rect[chip->screen.width * chip->screen.width];
-	for (unsigned int x = 0; x < chip->screen.width; x++) 
+	for (const RecompiledProgram *program : get_recompiled_programs())
 	{
-		for (unsigned int y = 0; y < chip->screen.height; y++) 
-		{
-			size_t index = x + (y * chip->screen.width);
-			if (chip->screen.data[index])
-			{
-				rects[index] = { static_cast<int>(x * pixel_scale + offsetX), static_cast<int>(y * pixel_scale + offsetY), pixel_scale, pixel_scale };
-			}
-		}
+		if (program->rom_size == rom_size && memcmp(program->rom, rom, rom_size) == 0) return program;
 	}
-	SDL_SetRenderDrawColor(renderer, 0x66, 0xFF, 0x66, 0xFF);
-	SDL_RenderFillRects(renderer, rects, static_cast<int>(chip->screen.width * chip->screen.width));
-	delete rects;
+	return nullptr;
+}
+
+void WorkingChip8::tick_timers()
+{
+	if (chip->registers.DT > 0) chip->registers.DT--;
+	if (chip->registers.ST > 0) chip->registers.ST--;
 }
\ No newline at end of file
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <cinttypes>
-#include <SDL.h>
 #include "Chip8.h"
 
 template<typename RT, typename T>
@@ -10,12 +9,33 @@ constexpr RT get_nibble(const T num, const unsigned int mask, const unsigned int
 	return static_cast<RT>((num & mask) >> (4 * nibble_shift));
 }
 
+struct WorkingChip8;
+struct RecompiledProgram;
+
+// Debug policy that does nothing, the plain run_cycle uses it so a run without the debugger pays nothing for the hooks
+struct NoDebugger
+{
+	inline bool before_cycle(WorkingChip8 &) { return true; }
+	inline void after_cycle(WorkingChip8 &) {}
+	inline void on_read(const uint16_t, const uint16_t) {}
+	inline void on_write(const uint16_t, const uint16_t) {}
+};
+
 struct WorkingChip8
 {
 	bool redraw = false;
 	bool halted = false;
 	bool waiting_for_input = false;
 
+	// Behaviour that differs between chip8 implementations
+	struct Quirks
+	{
+		// 8xy6 and 8xyE shift Vy into Vx instead of shifting Vx in place
+		bool shift_uses_vy = false;
+		// Fx55 and Fx65 leave I pointing behind the last register
+		bool load_store_increments_i = false;
+	} quirks;
+
 	Chip8 *const chip;
 	WorkingChip8(Chip8 *const chip);
 
@@ -27,9 +47,17 @@ struct WorkingChip8
 	uint16_t pop_stack();
 
 	bool execute(const uint16_t inst);
+	template<typename DebugPolicy>
+	bool execute(const uint16_t inst, DebugPolicy &debug);
 
 	unsigned long cycle_count = 0;
 	void run_cycle();
-
-	void draw(SDL_Renderer *const renderer, const unsigned int offsetX = 0, const unsigned int offsetY = 0, const int pixel_scale = 0);
+	// Runs a cycle with debugger hooks, definition is in WorkingChip8.inl
+	template<typename DebugPolicy>
+	void run_cycle(DebugPolicy &debug);
+	// Runs up to max_cycles instructions of recompiled code from PC, a single interpreted cycle when there is none that can run
+	void run_recompiled(const RecompiledProgram &program, const unsigned long max_cycles);
+
+	// Counts DT and ST down, call at 60Hz
+	void tick_timers();
 };
\ No newline at end of file
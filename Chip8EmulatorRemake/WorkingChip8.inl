@@ -0,0 +1,284 @@
+#pragma once
+
+// Template definitions for WorkingChip8, included by every translation unit that instantiates them with a debug policy
+#include "WorkingChip8.h"
+#include <cstdio>
+#include <cstdlib>
+
+template<typename DebugPolicy>
+bool WorkingChip8::execute(const uint16_t inst, DebugPolicy &debug)
+{
+	switch (get_nibble<uint8_t>(inst, 0xF000, 3)) {
+		case 0x0:
+		{
+			switch (inst & 0x00FF) {
+				case 0xE0:
+				{
+					for (unsigned int i = 0; i < chip->screen.width * chip->screen.height; i++) 
+					{
+						chip->screen.data[i] = 0;
+					}
+				} break;
+				case 0xEE:
+				{
+					chip->registers.PC = pop_stack();
+				} break;
+				case 0x00: // Halt in null memory
+				case 0xFD:
+				{
+					halted = true;
+				} break;
+				default: return false;
+			}
+		} break;
+		case 0x1:
+		{
+			uint16_t addr = inst & 0x0FFF;
+			chip->registers.PC = addr - 2;
+		} break;
+		case 0x2:
+		{
+			uint16_t addr = inst & 0x0FFF;
+			push_stack(chip->registers.PC);
+			chip->registers.PC = addr;
+		} break;
+		case 0x3:
+		{
+			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
+			uint16_t value = inst & 0x00FF;
+			if (chip->registers.V[register_index] == value) chip->registers.PC += 2;
+		} break;
+		case 0x4:
+		{
+			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
+			uint16_t value = inst & 0x00FF;
+			if (chip->registers.V[register_index] != value) chip->registers.PC += 2;
+		} break;
+		case 0x5:
+		{
+			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
+			uint8_t other_register_index = get_nibble<uint8_t>(inst, 0x00F0, 1);
+			if (chip->registers.V[register_index] == chip->registers.V[other_register_index]) chip->registers.PC += 2;
+		} break;
+		case 0x6:
+		{
+			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
+			uint8_t value = inst & 0x00FF;
+			chip->registers.V[register_index] = value;
+		} break;
+		case 0x7:
+		{
+			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
+			uint16_t value = inst & 0x00FF;
+			chip->registers.V[register_index] += value;
+		} break;
+		case 0x8:
+		{
+			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
+			uint8_t other_register_index = get_nibble<uint8_t>(inst, 0x00F0, 1);
+			switch (inst & 0x000F) {
+				case 0x0:
+				{
+					chip->registers.V[register_index] = chip->registers.V[other_register_index];
+				} break;
+				case 0x1:
+				{
+					chip->registers.V[register_index] |= chip->registers.V[other_register_index];
+				} break;
+				case 0x2:
+				{
+					chip->registers.V[register_index] &= chip->registers.V[other_register_index];
+				} break;
+				case 0x3:
+				{
+					chip->registers.V[register_index] ^= chip->registers.V[other_register_index];
+				} break;
+				case 0x4:
+				{
+					uint16_t res = chip->registers.V[register_index] + chip->registers.V[other_register_index];
+					chip->registers.VF = res > 0xFF ? 1 : 0;
+					chip->registers.V[register_index] = static_cast<uint8_t>(res & 0xFFFF);
+				} break;
+				case 0x5:
+				{
+					uint8_t Vx = chip->registers.V[register_index];
+					uint8_t Vy = chip->registers.V[other_register_index];
+					if (Vy > Vx) chip->registers.VF;
+					chip->registers.V[register_index] = Vx - Vy;
+				} break;
+				case 0x6:
+				{
+					if (quirks.shift_uses_vy) chip->registers.V[register_index] = chip->registers.V[other_register_index];
+					chip->registers.VF = (chip->registers.V[register_index] & 1) != 0 ? 1 : 0;
+					chip->registers.V[register_index] >>= 1;
+				} break;
+				case 0x7:
+				{
+					uint8_t Vx = chip->registers.V[register_index];
+					uint8_t Vy = chip->registers.V[other_register_index];
+					if (Vy > Vx) chip->registers.VF;
+					chip->registers.V[register_index] = Vy - Vx;
+				} break;
+				case 0xE:
+				{
+					if (quirks.shift_uses_vy) chip->registers.V[register_index] = chip->registers.V[other_register_index];
+					(chip->registers.VF = chip->registers.V[register_index] & (1 << 7)) != 0 ? 1 : 0;
+					chip->registers.V[register_index] <<= 1;
+				} break;
+				default: return false;
+			}
+		} break;
+		case 0x9:
+		{
+			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
+			uint8_t other_register_index = get_nibble<uint8_t>(inst, 0x00F0, 1);
+			if (chip->registers.V[register_index] != chip->registers.V[other_register_index]) chip->registers.PC++;
+		} break;
+		case 0xA:
+		{
+			uint16_t val = inst & 0x0FFF;
+			chip->registers.I = val;
+		} break;
+		case 0xB:
+		{
+			uint16_t addr = inst & 0x0FFF;
+			chip->registers.PC = chip->registers.V0 + addr;
+		} break;
+		case 0xC:
+		{
+			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
+			uint16_t value = inst & 0x00FF;
+			int n = rand() % 256;
+			chip->registers.V[register_index] += n & value;
+		} break;
+		case 0xD:
+		{
+			uint8_t pos_x = chip->registers.V[get_nibble<uint8_t>(inst, 0x0F00, 2)];
+			uint8_t pos_y = chip->registers.V[get_nibble<uint8_t>(inst, 0x00F0, 1)];
+			uint8_t n = inst & 0x000F;
+			debug.on_read(chip->registers.I, n);
+			chip->registers.VF = 0;
+			for (unsigned int y = 0; y < n; y++)
+			{
+				uint8_t pixel = chip->memory.data[chip->registers.I + y];
+				for (unsigned int x = 0; x < 8; x++)
+				{
+					if ((pixel & (0x80 >> x)) != 0) 
+					{
+						unsigned int index = ((pos_x + x) % chip->screen.width) + static_cast<unsigned int>(((pos_y + y) % chip->screen.height) * chip->screen.width);
+						chip->registers.VF = chip->screen.data[index];
+						chip->screen.data[index] ^= 1;
+					}
+				}
+			}
+			redraw = true;
+		} break;
+		case 0xE:
+		{
+			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
+			switch (inst & 0x00FF) {
+				case 0x9E:
+				{
+					uint8_t key = chip->registers.V[register_index];
+					if (chip->keyboard.data[key]) chip->registers.PC += 2;
+				} break;
+				case 0xA1:
+				{
+					uint8_t key = chip->registers.V[register_index];
+					if (!chip->keyboard.data[key]) chip->registers.PC += 2;
+				} break;
+				default: return false;
+			}
+		} break;
+		case 0xF:
+		{
+			uint8_t register_index = get_nibble<uint8_t>(inst, 0x0F00, 2);
+			switch (inst & 0x00FF) {
+				case 0x07:
+				{
+					chip->registers.V[register_index] = chip->registers.DT;
+				} break;
+				case 0x0A:
+				{
+					waiting_for_input = true;
+					for (int i = 0; i < chip->keyboard.size; i++)
+					{
+						if (chip->keyboard.data[i]) 
+						{
+							chip->registers.V[register_index] = i;
+							waiting_for_input = false;
+							break;
+						}
+					}
+				}
+				case 0x15:
+				{
+					chip->registers.DT = chip->registers.V[register_index];
+				} break;
+				case 0x18:
+				{
+					chip->registers.ST = chip->registers.V[register_index];
+				} break;
+				case 0x1E:
+				{
+					chip->registers.I += chip->registers.V[register_index];
+				} break;
+				case 0x29:
+				{
+					uint8_t key = chip->registers.V[register_index];
+					chip->registers.I = 0x50 + key * 5;
+				} break;
+				case 0x33:
+				{
+					debug.on_write(chip->registers.I, 3);
+					chip->memory.data[chip->registers.I] = chip->registers.V[register_index] / 100;
+					chip->memory.data[chip->registers.I + 1] = chip->registers.V[register_index] / 10 % 100;
+					chip->memory.data[chip->registers.I + 2] = chip->registers.V[register_index] % 10;
+				} break;
+				case 0x55:
+				{
+					debug.on_write(chip->registers.I, register_index + 1);
+					for (int i = 0; i <= register_index; i++) {
+						chip->memory.data[chip->registers.I + i] = chip->registers.V[i];
+					}
+					if (quirks.load_store_increments_i) chip->registers.I += register_index + 1;
+				} break;
+				case 0x65:
+				{
+					debug.on_read(chip->registers.I, register_index + 1);
+					for (int i = 0; i <= register_index; i++) {
+						chip->registers.V[i] = chip->memory.data[chip->registers.I + i];
+					}
+					if (quirks.load_store_increments_i) chip->registers.I += register_index + 1;
+				} break;
+				default: return false;
+			}
+		} break;
+		default: return false;
+	}
+	return true;
+}
+
+template<typename DebugPolicy>
+void WorkingChip8::run_cycle(DebugPolicy &debug)
+{
+	if (!debug.before_cycle(*this)) return;
+
+	uint16_t inst = ((uint16_t)chip->memory.data[chip->registers.PC] << 8) | chip->memory.data[chip->registers.PC + 1];
+	if (!execute(inst, debug)) 
+	{
+		printf("Unknown opcode %04x cycle %d line %d PC %04x\n", inst, cycle_count, (chip->registers.PC - 0x200) / 2, chip->registers.PC);
+	}
+
+	debug.after_cycle(*this);
+
+	if (waiting_for_input) return;
+	for (int i = 0; i < chip->keyboard.size; i++) {
+		chip->keyboard.data[i] = false;
+	}
+
+	chip->registers.PC += 2;
+	if (chip->registers.PC < 0x200) printf("Detected possible OOB code execution\n");
+
+	cycle_count++;
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "mappedfile.h"
+#include <cstdio>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+void MappedFile::swap(MappedFile &other)
+{
+	std::swap(data, other.data);
+	std::swap(size, other.size);
+#ifdef _WIN32
+	std::swap(file_handle, other.file_handle);
+	std::swap(mapping_handle, other.mapping_handle);
+#endif
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char *const path)
+{
+	close();
+	file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	return map();
+}
+
+bool MappedFile::open(const wchar_t *const path)
+{
+	close();
+	file_handle = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	return map();
+}
+
+bool MappedFile::map()
+{
+	if (file_handle == INVALID_HANDLE_VALUE)
+	{
+		file_handle = nullptr;
+		printf("Couldn't open file, error %lu\n", GetLastError());
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0)
+	{
+		// Empty files can't be mapped
+		close();
+		return false;
+	}
+
+	mapping_handle = CreateFileMappingW(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping_handle)
+	{
+		data = static_cast<const uint8_t *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	}
+	if (!data)
+	{
+		printf("Couldn't map file, error %lu\n", GetLastError());
+		close();
+		return false;
+	}
+	size = static_cast<size_t>(file_size.QuadPart);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data) UnmapViewOfFile(data);
+	if (mapping_handle) CloseHandle(mapping_handle);
+	if (file_handle) CloseHandle(file_handle);
+	data = nullptr;
+	size = 0;
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const char *const path)
+{
+	close();
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		perror("Couldn't open file");
+		return false;
+	}
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) < 0 || file_stat.st_size == 0)
+	{
+		// Empty files can't be mapped
+		::close(fd);
+		return false;
+	}
+
+	void *mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps the file alive on its own
+	::close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		perror("Couldn't map file");
+		return false;
+	}
+	data = static_cast<const uint8_t *>(mapping);
+	size = static_cast<size_t>(file_stat.st_size);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data) munmap(const_cast<uint8_t *>(data), size);
+	data = nullptr;
+	size = 0;
+}
+
+#endif
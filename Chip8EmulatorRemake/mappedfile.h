@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+// Read only memory mapping of a whole file, so ROMs can be loaded without copying them into a buffer first
+struct MappedFile
+{
+	const uint8_t *data = nullptr;
+	size_t size = 0;
+
+	~MappedFile();
+
+	bool open(const char *const path);
+#ifdef _WIN32
+	bool open(const wchar_t *const path);
+#endif
+	void close();
+	// Exchanges the mappings, lets a new file be opened before the current one is given up
+	void swap(MappedFile &other);
+
+private:
+#ifdef _WIN32
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+	bool map();
+#endif
+};
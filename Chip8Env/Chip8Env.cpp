@@ -0,0 +1,184 @@
+#include "chip8env.h"
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "WorkingChip8.h"
+#include "Recompiled.h"
+
+static const size_t memory_size = 4096;
+static const size_t stack_size = 16;
+
+struct Environment
+{
+	Chip8 chip;
+	WorkingChip8 working_chip;
+	uint32_t frame_count = 0;
+	// Reward bytes as of the end of the previous step
+	std::vector<uint8_t> reward_values;
+
+	Environment(uint8_t *const observation, const size_t reward_address_count)
+		: chip(memory_size, stack_size, CHIP8ENV_SCREEN_WIDTH, CHIP8ENV_SCREEN_HEIGHT, observation), working_chip(&chip), reward_values(reward_address_count)
+	{}
+};
+
+// Machine state right after the ROM was loaded, every reset copies it back
+struct Snapshot
+{
+	std::vector<uint8_t> memory;
+	std::vector<uint16_t> stack;
+	std::vector<uint8_t> screen;
+	Chip8::Registers registers;
+};
+
+struct chip8_vec_env
+{
+	chip8_env_config config;
+	std::vector<uint16_t> reward_addresses;
+	std::vector<std::unique_ptr<Environment>> environments;
+	Snapshot snapshot;
+	float *rewards;
+	uint8_t *dones;
+};
+
+static void take_snapshot(Snapshot &snapshot, const Chip8 &chip)
+{
+	snapshot.memory.assign(chip.memory.data, chip.memory.data + chip.memory.size);
+	snapshot.stack.assign(chip.stack.data, chip.stack.data + chip.stack.size);
+	snapshot.screen.assign(chip.screen.data, chip.screen.data + chip.screen.size);
+	snapshot.registers = chip.registers;
+}
+
+static void restore(const chip8_vec_env &envs, Environment &env)
+{
+	const Snapshot &snapshot = envs.snapshot;
+	Chip8 &chip = env.chip;
+	memcpy(chip.memory.data, snapshot.memory.data(), snapshot.memory.size());
+	memcpy(chip.stack.data, snapshot.stack.data(), snapshot.stack.size() * sizeof(uint16_t));
+	memcpy(chip.screen.data, snapshot.screen.data(), snapshot.screen.size());
+	chip.registers = snapshot.registers;
+	memset(chip.keyboard.data, 0, sizeof(chip.keyboard.data));
+
+	env.working_chip.halted = false;
+	env.working_chip.waiting_for_input = false;
+	env.working_chip.redraw = false;
+	env.working_chip.cycle_count = 0;
+	env.frame_count = 0;
+	for (size_t i = 0; i < envs.reward_addresses.size(); i++)
+	{
+		env.reward_values[i] = chip.memory.data[envs.reward_addresses[i]];
+	}
+}
+
+static bool is_done(const chip8_vec_env &envs, const Environment &env)
+{
+	if (env.working_chip.halted) return true;
+	if (envs.config.done_address >= 0 && env.chip.memory.data[envs.config.done_address] != 0) return true;
+	return envs.config.max_frames != 0 && env.frame_count >= envs.config.max_frames;
+}
+
+chip8_vec_env *chip8_vec_env_create(const chip8_env_config *config, size_t env_count, uint8_t *observations, float *rewards, uint8_t *dones)
+{
+	if (!config || !config->rom || config->rom_size == 0 || env_count == 0 || !observations || !rewards || !dones) return nullptr;
+	if (config->reward_address_count && !config->reward_addresses) return nullptr;
+	if (config->done_address >= static_cast<int32_t>(memory_size)) return nullptr;
+	for (size_t i = 0; i < config->reward_address_count; i++)
+	{
+		if (config->reward_addresses[i] >= memory_size) return nullptr;
+	}
+
+	chip8_vec_env *envs = new chip8_vec_env();
+	envs->config = *config;
+	envs->reward_addresses.assign(config->reward_addresses, config->reward_addresses + config->reward_address_count);
+	envs->config.reward_addresses = nullptr;
+	envs->rewards = rewards;
+	envs->dones = dones;
+	if (envs->config.cycles_per_frame == 0) envs->config.cycles_per_frame = 1;
+
+	// Each screen draws straight into its slice of the observations
+	envs->environments.reserve(env_count);
+	for (size_t i = 0; i < env_count; i++)
+	{
+		Environment *env = new Environment(observations + i * CHIP8ENV_OBSERVATION_SIZE, envs->reward_addresses.size());
+		env->working_chip.quirks.shift_uses_vy = (config->quirks & CHIP8ENV_QUIRK_SHIFT) != 0;
+		env->working_chip.quirks.load_store_increments_i = (config->quirks & CHIP8ENV_QUIRK_LOAD_STORE) != 0;
+		envs->environments.emplace_back(env);
+	}
+
+	WorkingChip8 &first = envs->environments[0]->working_chip;
+	first.reset();
+	first.load_program(config->rom, config->rom_size);
+	take_snapshot(envs->snapshot, *first.chip);
+
+	chip8_vec_env_reset(envs);
+	return envs;
+}
+
+void chip8_vec_env_destroy(chip8_vec_env *envs)
+{
+	delete envs;
+}
+
+const RecompiledProgram *chip8_env_find_recompiled_program(const uint8_t *rom, size_t rom_size)
+{
+	if (!rom) return nullptr;
+	return find_recompiled_program(rom, rom_size);
+}
+
+void chip8_vec_env_reset(chip8_vec_env *envs)
+{
+	for (size_t i = 0; i < envs->environments.size(); i++)
+	{
+		restore(*envs, *envs->environments[i]);
+		envs->rewards[i] = 0;
+		envs->dones[i] = 0;
+	}
+}
+
+void chip8_vec_env_step_batch(chip8_vec_env *envs, const uint16_t *actions, uint32_t frames_per_step)
+{
+	const uint32_t cycles_per_frame = envs->config.cycles_per_frame;
+	const RecompiledProgram *const program = envs->config.recompiled_program;
+	for (size_t i = 0; i < envs->environments.size(); i++)
+	{
+		Environment &env = *envs->environments[i];
+		WorkingChip8 &working_chip = env.working_chip;
+
+		// run_cycle releases every key after an instruction, so they are pressed again before each one
+		bool keys[Chip8::Keyboard::size];
+		for (size_t key = 0; key < Chip8::Keyboard::size; key++)
+		{
+			keys[key] = (actions[i] & (1 << key)) != 0;
+		}
+
+		bool done = false;
+		for (uint32_t frame = 0; frame < frames_per_step && !done; frame++)
+		{
+			for (uint32_t cycle = 0; cycle < cycles_per_frame && !working_chip.halted;)
+			{
+				memcpy(env.chip.keyboard.data, keys, sizeof(keys));
+				unsigned long previous_cycle_count = working_chip.cycle_count;
+				// Compiled code stops at the end of the frame so the timers tick after the same instruction
+				if (program) working_chip.run_recompiled(*program, cycles_per_frame - cycle);
+				else working_chip.run_cycle();
+				// A recompiled block runs several instructions at once, Fx0A waiting for a key runs none
+				unsigned long executed = working_chip.cycle_count - previous_cycle_count;
+				cycle += executed > 0 ? static_cast<uint32_t>(executed) : 1;
+			}
+			working_chip.tick_timers();
+			env.frame_count++;
+			done = is_done(*envs, env);
+		}
+
+		float reward = 0;
+		for (size_t address = 0; address < envs->reward_addresses.size(); address++)
+		{
+			uint8_t value = env.chip.memory.data[envs->reward_addresses[address]];
+			reward += static_cast<float>(static_cast<int>(value) - static_cast<int>(env.reward_values[address]));
+			env.reward_values[address] = value;
+		}
+		envs->rewards[i] = reward;
+		envs->dones[i] = done ? 1 : 0;
+
+		if (done) restore(*envs, env);
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+/*
+ * Batched chip8 environments for reinforcement learning, headless and with a C ABI.
+ *
+ * Observations, rewards and done flags are written straight into arrays the caller passes to
+ * chip8_vec_env_create, stepping never allocates or copies screens.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifdef CHIP8ENV_EXPORTS
+#define CHIP8ENV_API __declspec(dllexport)
+#else
+#define CHIP8ENV_API __declspec(dllimport)
+#endif
+#else
+#define CHIP8ENV_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHIP8ENV_SCREEN_WIDTH 64
+#define CHIP8ENV_SCREEN_HEIGHT 32
+/* Bytes per observation, one byte per pixel that is 0 or 1 */
+#define CHIP8ENV_OBSERVATION_SIZE (CHIP8ENV_SCREEN_WIDTH * CHIP8ENV_SCREEN_HEIGHT)
+
+/* 8xy6 and 8xyE shift Vy into Vx */
+#define CHIP8ENV_QUIRK_SHIFT 0x1
+/* Fx55 and Fx65 advance I */
+#define CHIP8ENV_QUIRK_LOAD_STORE 0x2
+
+/* Program written by Chip8Recompiler, generated files in Chip8Env\Recompiled are linked into the library */
+struct RecompiledProgram;
+
+typedef struct chip8_env_config
+{
+	const uint8_t *rom;
+	size_t rom_size;
+	/* Instructions per frame, the timers tick once per frame */
+	uint32_t cycles_per_frame;
+	/* The reward of a step is the summed change of the bytes at these addresses */
+	const uint16_t *reward_addresses;
+	size_t reward_address_count;
+	/* When not negative the episode is done once the byte at this address is non zero */
+	int32_t done_address;
+	/* Episodes are cut off after this many frames, 0 for no limit */
+	uint32_t max_frames;
+	/* CHIP8ENV_QUIRK_* flags */
+	uint32_t quirks;
+	/* Optional, from chip8_env_find_recompiled_program. The environments run its blocks and interpret everything it doesn't cover */
+	const struct RecompiledProgram *recompiled_program;
+} chip8_env_config;
+
+typedef struct chip8_vec_env chip8_vec_env;
+
+/*
+ * observations must hold env_count * CHIP8ENV_OBSERVATION_SIZE bytes, rewards and dones env_count entries.
+ * They are used by every step until the environments are destroyed. Returns null on invalid arguments.
+ */
+CHIP8ENV_API chip8_vec_env *chip8_vec_env_create(const chip8_env_config *config, size_t env_count, uint8_t *observations, float *rewards, uint8_t *dones);
+CHIP8ENV_API void chip8_vec_env_destroy(chip8_vec_env *envs);
+
+/* Returns the program linked into the library that was compiled from exactly these ROM bytes, or null */
+CHIP8ENV_API const struct RecompiledProgram *chip8_env_find_recompiled_program(const uint8_t *rom, size_t rom_size);
+
+CHIP8ENV_API void chip8_vec_env_reset(chip8_vec_env *envs);
+
+/*
+ * actions holds one key bitmask per environment, bit n is key n held down for the whole step.
+ * Environments that finish are reset right away, their observation is already the first of the next episode.
+ */
+CHIP8ENV_API void chip8_vec_env_step_batch(chip8_vec_env *envs, const uint16_t *actions, uint32_t frames_per_step);
+
+#ifdef __cplusplus
+}
+#endif
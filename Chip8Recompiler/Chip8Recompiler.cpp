@@ -0,0 +1,72 @@
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Recompiler.h"
+
+static FILE *open_file(const char *const path, const char *const mode)
+{
+	FILE *file = nullptr;
+#ifdef _MSC_VER
+	if (fopen_s(&file, path, mode) != 0) return nullptr;
+#else
+	file = fopen(path, mode);
+#endif
+	return file;
+}
+
+// recompiled_<file name without extension>, so every generated file in a project defines a different symbol
+static std::string get_default_name(const char *const output_path)
+{
+	const char *file_name = output_path;
+	for (const char *c = output_path; *c; c++)
+	{
+		if (*c == '/' || *c == '\\') file_name = c + 1;
+	}
+	const char *extension = strrchr(file_name, '.');
+	size_t length = extension ? static_cast<size_t>(extension - file_name) : strlen(file_name);
+
+	std::string name = "recompiled_";
+	for (size_t i = 0; i < length; i++)
+	{
+		name += isalnum(static_cast<unsigned char>(file_name[i])) ? file_name[i] : '_';
+	}
+	return name;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		printf("Usage: %s <rom> <output.cpp> [program name]\n", argv[0]);
+		printf("Writes the ROM as C++ basic blocks, the program name defaults to recompiled_<output file name>.\n"
+			"Put the output in Chip8Env\\Recompiled and get the program with chip8_env_find_recompiled_program,\n"
+			"or link it into any other frontend and pass it to WorkingChip8::run_recompiled\n");
+		return 1;
+	}
+	const std::string name = argc >= 4 ? argv[3] : get_default_name(argv[2]);
+
+	FILE *rom_file = open_file(argv[1], "rb");
+	if (!rom_file)
+	{
+		printf("Couldn't open ROM '%s'\n", argv[1]);
+		return 2;
+	}
+	// Everything from 0x200 to the end of the 4KB memory
+	std::vector<uint8_t> rom(4096 - 0x200);
+	size_t rom_size = fread(rom.data(), sizeof(uint8_t), rom.size(), rom_file);
+	fclose(rom_file);
+
+	FILE *output = open_file(argv[2], "w");
+	if (!output)
+	{
+		printf("Couldn't open output '%s'\n", argv[2]);
+		return 3;
+	}
+	size_t block_count = recompile(rom.data(), rom_size, name.c_str(), output);
+	fclose(output);
+
+	printf("Wrote %zu blocks for %zu bytes to %s\n", block_count, rom_size, argv[2]);
+	return 0;
+}
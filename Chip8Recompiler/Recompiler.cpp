@@ -0,0 +1,451 @@
+#include "Recompiler.h"
+#include "Disassembler.h"
+#include "WorkingChip8.h"
+#include <vector>
+
+// How an instruction leaves its block, the targets mirror what WorkingChip8::run_cycle ends up doing
+enum class Flow
+{
+	// Falls through to the next instruction
+	Next,
+	// Falls through, but ends the block since it writes memory which might be code
+	Store,
+	// 1NNN
+	Jump,
+	// 2NNN
+	Call,
+	// 3xkk, 4xkk, 5xy0, 9xy0, Ex9E, ExA1
+	Skip,
+	// 00EE and Bnnn, the target is only known at runtime
+	Indirect,
+	// Left to the interpreter (halt, Fx0A, unknown opcodes)
+	Interpret,
+};
+
+static const uint16_t program_start = 0x200;
+
+static Flow get_flow(const uint16_t inst)
+{
+	uint8_t kk = inst & 0x00FF;
+	uint8_t n = inst & 0x000F;
+	switch (get_nibble<uint8_t>(inst, 0xF000, 3)) {
+		case 0x0:
+		{
+			switch (kk) {
+				case 0xE0: return Flow::Next;
+				case 0xEE: return Flow::Indirect;
+			}
+		} break;
+		case 0x1: return Flow::Jump;
+		case 0x2: return Flow::Call;
+		case 0x3:
+		case 0x4:
+		case 0x5:
+		case 0x9: return Flow::Skip;
+		case 0x6:
+		case 0x7:
+		case 0xA:
+		case 0xC:
+		case 0xD: return Flow::Next;
+		case 0x8:
+		{
+			if (n <= 0x7 || n == 0xE) return Flow::Next;
+		} break;
+		case 0xB: return Flow::Indirect;
+		case 0xE:
+		{
+			if (kk == 0x9E || kk == 0xA1) return Flow::Skip;
+		} break;
+		case 0xF:
+		{
+			switch (kk) {
+				case 0x07:
+				case 0x15:
+				case 0x18:
+				case 0x1E:
+				case 0x29:
+				case 0x65: return Flow::Next;
+				case 0x33:
+				case 0x55: return Flow::Store;
+			}
+		} break;
+	}
+	return Flow::Interpret;
+}
+
+struct Rom
+{
+	const uint8_t *const data;
+	const size_t size;
+
+	inline bool contains(const uint32_t addr) const
+	{
+		return addr >= program_start && addr + 1 < program_start + size;
+	}
+	inline uint16_t read(const uint16_t addr) const
+	{
+		return ((uint16_t)data[addr - program_start] << 8) | data[addr - program_start + 1];
+	}
+};
+
+// Addresses execution can continue at after inst, as the interpreter computes them
+static void get_successors(const uint16_t addr, const uint16_t inst, std::vector<uint16_t> &successors)
+{
+	switch (get_flow(inst)) {
+		case Flow::Next:
+		case Flow::Store: successors.push_back(addr + 2); break;
+		case Flow::Jump: successors.push_back(inst & 0x0FFF); break;
+		case Flow::Call:
+		{
+			// The interpreter jumps to NNN and then steps past it, returning lands behind the call
+			successors.push_back((inst & 0x0FFF) + 2);
+			successors.push_back(addr + 2);
+		} break;
+		case Flow::Skip:
+		{
+			successors.push_back(addr + 2);
+			// 9xy0 only skips a single byte in the interpreter
+			successors.push_back(addr + ((inst & 0xF000) == 0x9000 ? 3 : 4));
+		} break;
+		case Flow::Indirect: break;
+		case Flow::Interpret:
+		{
+			// Everything but a halt continues behind itself, Fx0A once a key is pressed
+			if (inst != 0x0000 && inst != 0x00FD) successors.push_back(addr + 2);
+		} break;
+	}
+}
+
+// Writes inline C++ for instructions that fall through to the next one, returns false if it should go through WorkingChip8::execute instead
+static bool write_inline(FILE *const output, const uint16_t inst)
+{
+	uint16_t nnn = inst & 0x0FFF;
+	uint8_t kk = inst & 0x00FF;
+	uint8_t n = inst & 0x000F;
+	uint8_t x = get_nibble<uint8_t>(inst, 0x0F00, 2);
+	uint8_t y = get_nibble<uint8_t>(inst, 0x00F0, 1);
+	switch (get_nibble<uint8_t>(inst, 0xF000, 3)) {
+		case 0x0:
+		{
+			if (kk != 0xE0) break;
+			fprintf(output, "\tmemset(c.screen.data, 0, c.screen.width * c.screen.height);\n");
+		} return true;
+		case 0x6: fprintf(output, "\tV[0x%X] = 0x%02X;\n", x, kk); return true;
+		case 0x7: fprintf(output, "\tV[0x%X] += 0x%02X;\n", x, kk); return true;
+		case 0x8:
+		{
+			switch (n) {
+				case 0x0:
+				{
+					if (x != y) fprintf(output, "\tV[0x%X] = V[0x%X];\n", x, y);
+				} return true;
+				case 0x1: fprintf(output, "\tV[0x%X] |= V[0x%X];\n", x, y); return true;
+				case 0x2: fprintf(output, "\tV[0x%X] &= V[0x%X];\n", x, y); return true;
+				case 0x3: fprintf(output, "\tV[0x%X] ^= V[0x%X];\n", x, y); return true;
+				case 0x4: fprintf(output, "\t{ uint16_t res = V[0x%X] + V[0x%X]; V[0xF] = res > 0xFF ? 1 : 0; V[0x%X] = static_cast<uint8_t>(res); }\n", x, y, x); return true;
+				// The interpreter doesn't set VF for 8xy5 and 8xy7
+				case 0x5: fprintf(output, "\tV[0x%X] = static_cast<uint8_t>(V[0x%X] - V[0x%X]);\n", x, x, y); return true;
+				case 0x7: fprintf(output, "\tV[0x%X] = static_cast<uint8_t>(V[0x%X] - V[0x%X]);\n", x, y, x); return true;
+				case 0x6:
+				{
+					if (x != y) fprintf(output, "\tif (m.quirks.shift_uses_vy) V[0x%X] = V[0x%X];\n", x, y);
+					fprintf(output, "\tV[0xF] = V[0x%X] & 1;\n\tV[0x%X] >>= 1;\n", x, x);
+				} return true;
+				case 0xE:
+				{
+					if (x != y) fprintf(output, "\tif (m.quirks.shift_uses_vy) V[0x%X] = V[0x%X];\n", x, y);
+					fprintf(output, "\tV[0xF] = V[0x%X] & 0x80;\n\tV[0x%X] <<= 1;\n", x, x);
+				} return true;
+			}
+		} break;
+		case 0xA: fprintf(output, "\tc.registers.I = 0x%03X;\n", nnn); return true;
+		case 0xC: fprintf(output, "\tV[0x%X] += (rand() %% 256) & 0x%02X;\n", x, kk); return true;
+		case 0xD:
+		{
+			// Same pixel order as the interpreter so VF ends up the same, the wrap assumes the screen is at least 8 pixels wide
+			fprintf(output,
+				"\t{\n"
+				"\t\tconst size_t width = c.screen.width;\n"
+				"\t\tconst unsigned int start_x = V[0x%X] %% width;\n"
+				"\t\tconst uint8_t pos_y = V[0x%X];\n"
+				"\t\tV[0xF] = 0;\n"
+				"\t\tfor (unsigned int y = 0; y < %u; y++)\n"
+				"\t\t{\n"
+				"\t\t\tconst uint8_t pixel = c.memory.data[c.registers.I + y];\n"
+				"\t\t\tif (!pixel) continue;\n"
+				"\t\t\tuint8_t *const row = c.screen.data + ((pos_y + y) %% c.screen.height) * width;\n"
+				"\t\t\tfor (unsigned int x = 0; x < 8; x++)\n"
+				"\t\t\t{\n"
+				"\t\t\t\tif ((pixel & (0x80 >> x)) == 0) continue;\n"
+				"\t\t\t\tunsigned int column = start_x + x;\n"
+				"\t\t\t\tif (column >= width) column -= static_cast<unsigned int>(width);\n"
+				"\t\t\t\tV[0xF] = row[column];\n"
+				"\t\t\t\trow[column] ^= 1;\n"
+				"\t\t\t}\n"
+				"\t\t}\n"
+				"\t\tm.redraw = true;\n"
+				"\t}\n", x, y, n);
+		} return true;
+		case 0xF:
+		{
+			switch (kk) {
+				case 0x07: fprintf(output, "\tV[0x%X] = c.registers.DT;\n", x); return true;
+				case 0x15: fprintf(output, "\tc.registers.DT = V[0x%X];\n", x); return true;
+				case 0x18: fprintf(output, "\tc.registers.ST = V[0x%X];\n", x); return true;
+				case 0x1E: fprintf(output, "\tc.registers.I += V[0x%X];\n", x); return true;
+				case 0x29: fprintf(output, "\tc.registers.I = 0x50 + V[0x%X] * 5;\n", x); return true;
+				case 0x33:
+				{
+					// Middle digit keeps the interpreter's / 10 % 100
+					fprintf(output, "\t{ uint8_t *const out = c.memory.data + c.registers.I; const uint8_t value = V[0x%X]; out[0] = value / 100; out[1] = value / 10 %% 100; out[2] = value %% 10; }\n", x);
+				} return true;
+				case 0x55:
+				{
+					fprintf(output, "\tmemcpy(c.memory.data + c.registers.I, V, %u);\n", x + 1);
+					fprintf(output, "\tif (m.quirks.load_store_increments_i) c.registers.I += %u;\n", x + 1);
+				} return true;
+				case 0x65:
+				{
+					fprintf(output, "\tmemcpy(V, c.memory.data + c.registers.I, %u);\n", x + 1);
+					fprintf(output, "\tif (m.quirks.load_store_increments_i) c.registers.I += %u;\n", x + 1);
+				} return true;
+			}
+		} break;
+	}
+	return false;
+}
+
+// Whether the code written for inst reads or writes V, so V is only declared when something uses it
+static bool uses_registers(const uint16_t inst)
+{
+	uint8_t x = get_nibble<uint8_t>(inst, 0x0F00, 2);
+	uint8_t y = get_nibble<uint8_t>(inst, 0x00F0, 1);
+	switch (get_nibble<uint8_t>(inst, 0xF000, 3)) {
+		case 0x0:
+		case 0x1:
+		case 0x2:
+		case 0xA: return false;
+		case 0x5:
+		case 0x9: return x != y;
+		case 0x8: return (inst & 0x000F) != 0x0 || x != y;
+	}
+	return true;
+}
+
+struct Block
+{
+	uint16_t start;
+	// Address behind the last instruction
+	uint16_t end;
+};
+
+static uint16_t find_block_end(const Rom &rom, const std::vector<bool> &leaders, const uint16_t start)
+{
+	uint16_t addr = start;
+	while (true)
+	{
+		uint16_t next = addr + 2;
+		if (get_flow(rom.read(addr)) != Flow::Next || !rom.contains(next) || leaders[next] || get_flow(rom.read(next)) == Flow::Interpret) return next;
+		addr = next;
+	}
+}
+
+static bool is_key_skip(const uint16_t inst)
+{
+	return (inst & 0xF000) == 0xE000 && get_flow(inst) == Flow::Skip;
+}
+
+// Continues at a statically known address, straight into its block when there is one and back to the caller otherwise
+static void write_exit(FILE *const output, const uint16_t target, const std::vector<bool> &block_starts)
+{
+	if (target < block_starts.size() && block_starts[target]) fprintf(output, "goto block_%03X;\n", target);
+	else fprintf(output, "{ c.registers.PC = 0x%03X; goto done; }\n", target);
+}
+
+static void write_block(FILE *const output, const Rom &rom, const Block &block, const std::vector<bool> &block_starts)
+{
+	const unsigned int count = (block.end - block.start) / 2;
+	fprintf(output, "block_%03X:\n", block.start);
+	// Changed code, the end of the budget and key checks after the first instruction (the caller presses keys again) go back to the caller
+	fprintf(output, "\tif (%smax_cycles - cycles < %u || memcmp(c.memory.data + 0x%03X, original_code + 0x%03X, %u) != 0) { c.registers.PC = 0x%03X; goto done; }\n",
+		is_key_skip(rom.read(block.start)) ? "cycles != 0 || " : "", count, block.start, block.start - program_start, block.end - block.start, block.start);
+
+	for (uint16_t addr = block.start; addr < block.end; addr += 2)
+	{
+		const uint16_t inst = rom.read(addr);
+		const Flow flow = get_flow(inst);
+		const bool first = addr == block.start;
+		const bool last = addr + 2 >= block.end;
+		const uint8_t x = get_nibble<uint8_t>(inst, 0x0F00, 2);
+		const uint8_t y = get_nibble<uint8_t>(inst, 0x00F0, 1);
+
+		char text[32];
+		disassemble(inst, text, sizeof(text));
+		fprintf(output, "\t// %03X: %04X  %s\n", addr, inst, text);
+
+		// Condition of a skip, null when it is known at compile time
+		const char *skip_format = nullptr;
+		bool skip_always = false;
+		const char *indent = "\t";
+		switch (flow) {
+			case Flow::Next:
+			case Flow::Store:
+			{
+				if (!write_inline(output, inst))
+				{
+					fprintf(output, "\tc.registers.PC = 0x%03X;\n\tm.execute(0x%04X);\n", addr, inst);
+				}
+			} break;
+			case Flow::Call: fprintf(output, "\tm.push_stack(0x%03X);\n", addr); break;
+			case Flow::Indirect:
+			{
+				if ((inst & 0xF000) == 0xB000) fprintf(output, "\tc.registers.PC = static_cast<uint16_t>(V[0x0] + 0x%03X + 2);\n", inst & 0x0FFF);
+				else fprintf(output, "\tc.registers.PC = static_cast<uint16_t>(m.pop_stack() + 2);\n");
+			} break;
+			case Flow::Skip:
+			{
+				switch (get_nibble<uint8_t>(inst, 0xF000, 3)) {
+					case 0x3: skip_format = "V[0x%X] == 0x%02X"; break;
+					case 0x4: skip_format = "V[0x%X] != 0x%02X"; break;
+					case 0x5: if (x == y) skip_always = true; else skip_format = "V[0x%X] == V[0x%X]"; break;
+					case 0x9: if (x != y) skip_format = "V[0x%X] != V[0x%X]"; break;
+					case 0xE: skip_format = (inst & 0x00FF) == 0x9E ? "c.keyboard.data[V[0x%X]]" : "!c.keyboard.data[V[0x%X]]"; break;
+				}
+				if (skip_format)
+				{
+					// Evaluated before the keyboard is cleared, in its own scope so gotos to later blocks don't jump over it
+					fprintf(output, "\t{\n\t\tconst bool skip = ");
+					fprintf(output, skip_format, x, (inst & 0xF000) == 0x5000 || (inst & 0xF000) == 0x9000 ? y : inst & 0x00FF);
+					fprintf(output, ";\n");
+					indent = "\t\t";
+				}
+			} break;
+			default: break;
+		}
+
+		// run_cycle clears the keyboard after every instruction, after the first one it stays clear
+		if (first) fprintf(output, "%smemset(c.keyboard.data, 0, sizeof(c.keyboard.data));\n", indent);
+		if (!last) continue;
+
+		fprintf(output, "%scycles += %u;\n%s", indent, count, indent);
+		switch (flow) {
+			case Flow::Jump: write_exit(output, inst & 0x0FFF, block_starts); break;
+			// The interpreter lands behind the first instruction of a subroutine
+			case Flow::Call: write_exit(output, (inst & 0x0FFF) + 2, block_starts); break;
+			case Flow::Indirect: fprintf(output, "goto dispatch;\n"); break;
+			case Flow::Skip:
+			{
+				// 9xy0 only skips a single byte in the interpreter
+				const uint16_t skip_target = addr + ((inst & 0xF000) == 0x9000 ? 3 : 4);
+				if (skip_format)
+				{
+					fprintf(output, "if (skip) ");
+					write_exit(output, skip_target, block_starts);
+					fprintf(output, "%s", indent);
+				}
+				write_exit(output, skip_always ? skip_target : addr + 2, block_starts);
+				if (skip_format) fprintf(output, "\t}\n");
+			} break;
+			default: write_exit(output, addr + 2, block_starts); break;
+		}
+	}
+}
+
+size_t recompile(const uint8_t *const rom_data, const size_t rom_size, const char *const name, FILE *const output)
+{
+	const Rom rom = { rom_data, rom_size };
+	const size_t address_count = program_start + rom_size + 2;
+
+	// Walk everything reachable from the entry point, marking where blocks have to start
+	std::vector<bool> reachable(address_count, false);
+	std::vector<bool> leaders(address_count, false);
+	std::vector<uint16_t> worklist = { program_start };
+	std::vector<uint16_t> successors;
+	leaders[program_start] = true;
+	while (!worklist.empty())
+	{
+		uint16_t addr = worklist.back();
+		worklist.pop_back();
+		if (!rom.contains(addr) || reachable[addr]) continue;
+		reachable[addr] = true;
+
+		uint16_t inst = rom.read(addr);
+		successors.clear();
+		get_successors(addr, inst, successors);
+		Flow flow = get_flow(inst);
+		// Key skips start their own block so they see the keys held when the block is entered, not the cleared ones
+		if (is_key_skip(inst)) leaders[addr] = true;
+		for (uint16_t successor : successors)
+		{
+			if (!rom.contains(successor)) continue;
+			if (flow != Flow::Next) leaders[successor] = true;
+			worklist.push_back(successor);
+		}
+	}
+
+	std::vector<Block> blocks;
+	std::vector<bool> block_starts(address_count, false);
+	bool has_indirect = false;
+	bool needs_registers = false;
+	for (uint16_t addr = program_start; rom.contains(addr); addr++)
+	{
+		if (!reachable[addr] || !leaders[addr]) continue;
+		if (get_flow(rom.read(addr)) == Flow::Interpret) continue;
+		Block block = { addr, find_block_end(rom, leaders, addr) };
+		for (uint16_t inst_addr = block.start; inst_addr < block.end; inst_addr += 2)
+		{
+			uint16_t inst = rom.read(inst_addr);
+			has_indirect |= get_flow(inst) == Flow::Indirect;
+			needs_registers |= uses_registers(inst);
+		}
+		blocks.push_back(block);
+		block_starts[addr] = true;
+	}
+
+	fprintf(output, "// Generated by Chip8Recompiler, do not edit\n");
+	fprintf(output, "#include \"Recompiled.h\"\n");
+	fprintf(output, "#include <cstdlib>\n");
+	fprintf(output, "#include <cstring>\n\n");
+	fprintf(output, "namespace\n{\n\n");
+
+	fprintf(output, "const uint8_t original_code[%zu] = {", rom_size > 0 ? rom_size : 1);
+	for (size_t i = 0; i < rom_size; i++)
+	{
+		fprintf(output, "%s0x%02X,", i % 16 == 0 ? "\n\t" : " ", rom_data[i]);
+	}
+	fprintf(output, "\n};\n\n");
+
+	if (blocks.empty())
+	{
+		fprintf(output, "unsigned long run(WorkingChip8 &, const unsigned long)\n{\n\treturn 0;\n}\n\n");
+	}
+	else
+	{
+		fprintf(output, "unsigned long run(WorkingChip8 &m, const unsigned long max_cycles)\n{\n");
+		fprintf(output, "\tChip8 &c = *m.chip;\n");
+		if (needs_registers) fprintf(output, "\tuint8_t *const V = c.registers.V;\n");
+		fprintf(output, "\tunsigned long cycles = 0;\n\n");
+		// Entry, and where 00EE and Bnnn come back to since their target is only known at runtime
+		if (has_indirect) fprintf(output, "dispatch:\n");
+		fprintf(output, "\tswitch (c.registers.PC) {\n");
+		for (const Block &block : blocks)
+		{
+			fprintf(output, "\t\tcase 0x%03X: goto block_%03X;\n", block.start, block.start);
+		}
+		fprintf(output, "\t}\n\tgoto done;\n\n");
+
+		for (const Block &block : blocks)
+		{
+			write_block(output, rom, block, block_starts);
+			fprintf(output, "\n");
+		}
+
+		fprintf(output, "done:\n\tm.cycle_count += cycles;\n\treturn cycles;\n}\n\n");
+	}
+
+	fprintf(output, "struct Registration\n{\n\tRegistration(const RecompiledProgram &program)\n\t{\n\t\tregister_recompiled_program(program);\n\t}\n};\n\n");
+	fprintf(output, "}\n\n");
+	fprintf(output, "extern const RecompiledProgram %s = { original_code, %zu, run };\n", name, rom_size);
+	fprintf(output, "static const Registration %s_registration(%s);\n", name, name);
+	return blocks.size();
+}
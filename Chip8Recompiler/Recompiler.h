@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstdio>
+
+// Recovers the basic blocks of a ROM loaded at 0x200 and writes them out as C++ source, one label per block in a single function.
+// The generated file defines `extern const RecompiledProgram <name>` for WorkingChip8::run_recompiled and registers it for find_recompiled_program.
+// Returns the number of blocks written.
+size_t recompile(const uint8_t *const rom, const size_t rom_size, const char *const name, FILE *const output);